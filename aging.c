@@ -0,0 +1,376 @@
+/*
+ * aging.c - how the block allocator ages under churn
+ * Runs the core in-process from libramdisk.a and repeats cycles of
+ * create, append and unlink that keep the ramdisk near a fill level.
+ * Every few cycles it samples what the history has done to the
+ * allocator: the cost of getFreeBlock, how many separate runs of blocks
+ * the files are stored in, and how fast they read back sequentially.
+ * One CSV line per sample.
+ *
+ * Usage: aging [-c cycles] [-e every] [-f files] [-u fill%]
+ *              [-s min,max] [-r seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include "ramdisk.h"
+
+#define AGING_PATH_MAX 32
+#define AGING_CHUNK 4096
+#define AGING_ALLOC_SAMPLES 256
+
+// appends stop short of the largest file so they do not start failing
+#define AGING_MAX_FILE (MAX_FILE_SIZE / 2)
+
+typedef struct {
+    int cycles;
+    int every;
+    int files;
+    int fillPercent;
+    int minAppend;
+    int maxAppend;
+    unsigned long random;
+} agingConfig;
+
+typedef struct {
+    int live;
+    int size;
+} agingFile;
+
+typedef struct {
+    long appendNs;
+    long appends;
+    long failedAppends;
+} agingCycle;
+
+static long nowNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static unsigned long nextRandom(agingConfig* config)
+{
+    //xorshift64*
+    config->random ^= config->random >> 12;
+    config->random ^= config->random << 25;
+    config->random ^= config->random >> 27;
+    return config->random * 2685821657736338717UL;
+}
+
+// log-uniform, so small appends are as common as large ones per decade
+static int nextAppend(agingConfig* config)
+{
+    double u;
+
+    u = (nextRandom(config) >> 11) * (1.0 / 9007199254740992.0);
+    return (int) exp(log(config->minAppend) + u * (log(config->maxAppend) - log(config->minAppend)));
+}
+
+static void filePath(int file, char* path)
+{
+    sprintf(path, "/age/a%d", file);
+}
+
+static int usedPercent(void)
+{
+    return (int) (100L * (RD_BLOCK_COUNT - sb->freeBlocks) / RD_BLOCK_COUNT);
+}
+
+static int appendTo(agingFile* file, int index, char* buffer, int length)
+{
+    char path[AGING_PATH_MAX];
+    int fd, ret;
+
+    filePath(index, path);
+    fd = ram_open(path);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ret = ram_pwrite(fd, buffer, length, file->size);
+    ram_close(fd);
+    if (ret > 0)
+    {
+        file->size += ret;
+    }
+    return ret == length ? 0 : -1;
+}
+
+// one cycle: bring the file count back up, append to random files until
+// the fill level is reached, then unlink a tenth of the files and more
+// while the ramdisk is over it
+static void runCycle(agingConfig* config, agingFile* files, char* buffer, agingCycle* cycle)
+{
+    char path[AGING_PATH_MAX];
+    agingFile* file;
+    long started;
+    int index, length, tries, victims;
+
+    for (index = 0; index < config->files; index++)
+    {
+        if (!files[index].live)
+        {
+            filePath(index, path);
+            if (ram_creat(path) >= 0)
+            {
+                files[index].live = 1;
+                files[index].size = 0;
+            }
+        }
+    }
+
+    for (tries = 0; tries < config->files * 4 && usedPercent() < config->fillPercent; tries++)
+    {
+        index = nextRandom(config) % config->files;
+        file = &files[index];
+        length = nextAppend(config);
+        if (!file->live || file->size + length > AGING_MAX_FILE)
+        {
+            continue;
+        }
+        started = nowNs();
+        if (appendTo(file, index, buffer, length) == 0)
+        {
+            cycle->appendNs += nowNs() - started;
+            cycle->appends++;
+        }
+        else
+        {
+            cycle->failedAppends++;
+        }
+    }
+
+    victims = config->files / 10;
+    for (tries = 0; tries < config->files * 4 && (victims > 0 || usedPercent() > config->fillPercent); tries++)
+    {
+        index = nextRandom(config) % config->files;
+        if (!files[index].live)
+        {
+            continue;
+        }
+        filePath(index, path);
+        if (ram_unlink(path) >= 0)
+        {
+            files[index].live = 0;
+            victims--;
+        }
+    }
+}
+
+static int compareLong(const void* a, const void* b)
+{
+    long x = *(const long*) a;
+    long y = *(const long*) b;
+
+    return (x > y) - (x < y);
+}
+
+// times getFreeBlock on the bitmap as it is, giving every block back
+static void sampleAllocation(long* mean, long* p50, long* p99)
+{
+    char* blocks[AGING_ALLOC_SAMPLES];
+    long samples[AGING_ALLOC_SAMPLES];
+    long started, sum;
+    int count, i;
+
+    sum = 0;
+    for (count = 0; count < AGING_ALLOC_SAMPLES; count++)
+    {
+        started = nowNs();
+        blocks[count] = getFreeBlock();
+        samples[count] = nowNs() - started;
+        if (!blocks[count])
+        {
+            break;
+        }
+        sum += samples[count];
+    }
+    for (i = 0; i < count; i++)
+    {
+        setBitmap(blocks[i]);
+    }
+
+    *mean = *p50 = *p99 = 0;
+    if (count > 0)
+    {
+        qsort(samples, count, sizeof(long), compareLong);
+        *mean = sum / count;
+        *p50 = samples[count / 2];
+        *p99 = samples[count * 99 / 100];
+    }
+}
+
+// extents per file and blocks per extent over the files holding data
+static void sampleExtents(agingConfig* config, agingFile* files, double* perFile, double* blocksPerExtent)
+{
+    char path[AGING_PATH_MAX];
+    long extents, blocks;
+    int index, inodeNumber, counted;
+
+    extents = blocks = 0;
+    counted = 0;
+    for (index = 0; index < config->files; index++)
+    {
+        if (!files[index].live || files[index].size == 0)
+        {
+            continue;
+        }
+        filePath(index, path);
+        inodeNumber = lockPathInode(path, "reg", FALSE);
+        if (inodeNumber == -1)
+        {
+            continue;
+        }
+        extents += countFileExtents(&inodeArray[inodeNumber]);
+        blocks += (inodeArray[inodeNumber].size + RD_BLOCK_SIZE - 1) / RD_BLOCK_SIZE;
+        unlockInode(inodeNumber, FALSE);
+        counted++;
+    }
+    *perFile = counted ? (double) extents / counted : 0;
+    *blocksPerExtent = extents ? (double) blocks / extents : 0;
+}
+
+// reads every file front to back
+static double sampleReadMBs(agingConfig* config, agingFile* files, char* buffer)
+{
+    char path[AGING_PATH_MAX];
+    long started, bytes, elapsed;
+    int index, fd, ret;
+
+    bytes = 0;
+    started = nowNs();
+    for (index = 0; index < config->files; index++)
+    {
+        if (!files[index].live)
+        {
+            continue;
+        }
+        filePath(index, path);
+        fd = ram_open(path);
+        if (fd < 0)
+        {
+            continue;
+        }
+        while ((ret = ram_read(fd, buffer, AGING_CHUNK)) > 0)
+        {
+            bytes += ret;
+        }
+        ram_close(fd);
+    }
+    elapsed = nowNs() - started;
+    return elapsed > 0 ? bytes * 1e3 / elapsed : 0;
+}
+
+static void usage(char* name)
+{
+    fprintf(stderr, "usage: %s [-c cycles] [-e every] [-f files] [-u fill%%] [-s min,max] [-r seed]\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+    agingConfig config;
+    agingFile* files;
+    agingCycle cycle;
+    char* buffer;
+    double perFile, blocksPerExtent, readMBs;
+    long allocMean, allocP50, allocP99;
+    int option, round, live, index;
+
+    memset(&config, 0, sizeof(agingConfig));
+    config.cycles = 500;
+    config.every = 10;
+    config.files = 200;
+    config.fillPercent = 80;
+    config.minAppend = 64;
+    config.maxAppend = 16384;
+    config.random = 88172645463325252UL;
+
+    while ((option = getopt(argc, argv, "c:e:f:u:s:r:")) != -1)
+    {
+        switch (option)
+        {
+            case 'c':
+                config.cycles = atoi(optarg);
+                break;
+            case 'e':
+                config.every = atoi(optarg);
+                break;
+            case 'f':
+                config.files = atoi(optarg);
+                break;
+            case 'u':
+                config.fillPercent = atoi(optarg);
+                break;
+            case 's':
+                if (sscanf(optarg, "%d,%d", &config.minAppend, &config.maxAppend) != 2)
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'r':
+                config.random = strtoul(optarg, NULL, 0) | 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (config.cycles < 1 || config.every < 1 || config.files < 10 || config.files > INODE_COUNT - 2 ||
+        config.fillPercent < 1 || config.fillPercent > 95 || config.minAppend < 1 ||
+        config.maxAppend < config.minAppend || config.maxAppend > AGING_MAX_FILE)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (initRamdisk() < 0 || ram_mkdir("/age") < 0)
+    {
+        fprintf(stderr, "aging: cannot set up the ramdisk\n");
+        return 1;
+    }
+    files = (agingFile*) calloc(config.files, sizeof(agingFile));
+    buffer = (char*) malloc(AGING_MAX_FILE);
+    memset(buffer, 'g', AGING_MAX_FILE);
+
+    printf("cycle,files,used_pct,alloc_mean_ns,alloc_p50_ns,alloc_p99_ns,append_mean_ns,failed_appends,"
+           "extents_per_file,blocks_per_extent,seq_read_mb_s\n");
+    memset(&cycle, 0, sizeof(agingCycle));
+    for (round = 1; round <= config.cycles; round++)
+    {
+        runCycle(&config, files, buffer, &cycle);
+        if (round % config.every != 0 && round != config.cycles)
+        {
+            continue;
+        }
+
+        sampleAllocation(&allocMean, &allocP50, &allocP99);
+        sampleExtents(&config, files, &perFile, &blocksPerExtent);
+        readMBs = sampleReadMBs(&config, files, buffer);
+        live = 0;
+        for (index = 0; index < config.files; index++)
+        {
+            live += files[index].live;
+        }
+
+        printf("%d,%d,%d,%ld,%ld,%ld,%ld,%ld,%.2f,%.2f,%.1f\n",
+               round, live, usedPercent(), allocMean, allocP50, allocP99,
+               cycle.appends ? cycle.appendNs / cycle.appends : 0, cycle.failedAppends,
+               perFile, blocksPerExtent, readMBs);
+        fflush(stdout);
+        memset(&cycle, 0, sizeof(agingCycle));
+    }
+
+    free(buffer);
+    free(files);
+    destroyRamdisk();
+    return 0;
+}
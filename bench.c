@@ -0,0 +1,984 @@
+/*
+ * bench.c - latency and throughput of every ramdisk operation
+ * Builds two ways: bench drives the module through /proc/ramdisk_ioctl,
+ * bench_lib (-DBENCH_IN_PROCESS) links libramdisk.a and runs the core in
+ * this process. Each configuration of file count, directory fan-out and
+ * thread count runs the phases below in order, every thread in its own
+ * subtree, and every operation is timed on its own. With -d the same
+ * workloads also run in a tmpfs directory and the two are reported side
+ * by side; use bench for that, since bench_lib skips the system call that
+ * the module and tmpfs both pay.
+ *
+ * Usage: bench [-n files,...] [-f fanout,...] [-t threads,...]
+ *              [-s size,...] [-i iterations] [-o csv|json] [-d tmpfs-dir]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#ifdef BENCH_IN_PROCESS
+#include "ramdisk.h"
+#else
+#include "ramdisk_ioctl.h"
+#endif
+
+#define BENCH_MAX_LIST 8
+#define BENCH_PATH_MAX 128
+#define BENCH_ENTRY_SIZE 64
+
+// every thread reads and writes one file of this size
+#define BENCH_DATA_SIZE (128 * 1024)
+
+// the ramdisk holds 1024 inodes; configurations needing more are skipped
+#define BENCH_MAX_INODES 1000
+
+// descriptors a thread holds between its open and close rounds
+#define BENCH_OPEN_BATCH 16
+
+// the operations every backend provides, in the shape of the ram_* calls;
+// each returns a negative value on failure
+typedef struct {
+    char* name;
+    char* root;
+    int (*creat)(char* pathname);
+    int (*mkdir)(char* pathname);
+    int (*open)(char* pathname);
+    int (*close)(int fd);
+    int (*read)(int fd, char* address, int num_bytes);
+    int (*write)(int fd, char* address, int num_bytes);
+    int (*pread)(int fd, char* address, int num_bytes, int offset);
+    int (*pwrite)(int fd, char* address, int num_bytes, int offset);
+    int (*lseek)(int fd, int offset);
+    int (*readdir)(int fd, char* address);  // 1 per entry, 0 at the end
+    int (*unlink)(char* pathname);
+    int (*rmdir)(char* pathname);
+} benchBackend;
+
+#ifdef BENCH_IN_PROCESS
+
+static benchBackend ramdiskBackend = {
+    "ramdisk", "",
+    ram_creat, ram_mkdir, ram_open, ram_close, ram_read, ram_write,
+    ram_pread, ram_pwrite, ram_lseek, ram_readdir, ram_unlink, ram_unlink,
+};
+
+#else
+
+static int deviceFd;
+
+static int benchRdCreat(char* pathname) { return rd_creat(deviceFd, pathname); }
+static int benchRdMkdir(char* pathname) { return rd_mkdir(deviceFd, pathname); }
+static int benchRdOpen(char* pathname) { return rd_open(deviceFd, pathname); }
+static int benchRdClose(int fd) { return rd_close(deviceFd, fd); }
+static int benchRdRead(int fd, char* address, int num_bytes) { return rd_read(deviceFd, fd, address, num_bytes); }
+static int benchRdWrite(int fd, char* address, int num_bytes) { return rd_write(deviceFd, fd, address, num_bytes); }
+static int benchRdPread(int fd, char* address, int num_bytes, int offset) { return rd_pread(deviceFd, fd, address, num_bytes, offset); }
+static int benchRdPwrite(int fd, char* address, int num_bytes, int offset) { return rd_pwrite(deviceFd, fd, address, num_bytes, offset); }
+static int benchRdLseek(int fd, int offset) { return rd_lseek(deviceFd, fd, offset); }
+static int benchRdReaddir(int fd, char* address) { return rd_readdir(deviceFd, fd, address); }
+static int benchRdUnlink(char* pathname) { return rd_unlink(deviceFd, pathname); }
+
+static benchBackend ramdiskBackend = {
+    "ramdisk", "",
+    benchRdCreat, benchRdMkdir, benchRdOpen, benchRdClose, benchRdRead, benchRdWrite,
+    benchRdPread, benchRdPwrite, benchRdLseek, benchRdReaddir, benchRdUnlink, benchRdUnlink,
+};
+
+#endif
+
+// the same calls on an ordinary directory, as test.c does without
+// USE_RAMDISK; meant for a tmpfs mount so the two can be compared
+#define BENCH_POSIX_FDS 4096
+
+// directory streams of the descriptors readdir was used on
+static DIR* posixDirs[BENCH_POSIX_FDS];
+
+static int benchPosixCreat(char* pathname)
+{
+    int fd;
+
+    fd = creat(pathname, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    return fd < 0 ? -1 : close(fd);
+}
+
+static int benchPosixMkdir(char* pathname)
+{
+    return mkdir(pathname, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+}
+
+static int benchPosixOpen(char* pathname)
+{
+    int fd;
+
+    fd = open(pathname, O_RDWR);
+    if (fd < 0 && errno == EISDIR)
+    {
+        fd = open(pathname, O_RDONLY | O_DIRECTORY);
+    }
+    return fd;
+}
+
+static int benchPosixClose(int fd)
+{
+    DIR* dir;
+
+    if (fd >= 0 && fd < BENCH_POSIX_FDS && posixDirs[fd])
+    {
+        dir = posixDirs[fd];
+        posixDirs[fd] = NULL;
+        return closedir(dir);
+    }
+    return close(fd);
+}
+
+static int benchPosixRead(int fd, char* address, int num_bytes) { return read(fd, address, num_bytes); }
+static int benchPosixWrite(int fd, char* address, int num_bytes) { return write(fd, address, num_bytes); }
+static int benchPosixPread(int fd, char* address, int num_bytes, int offset) { return pread(fd, address, num_bytes, offset); }
+static int benchPosixPwrite(int fd, char* address, int num_bytes, int offset) { return pwrite(fd, address, num_bytes, offset); }
+static int benchPosixLseek(int fd, int offset) { return lseek(fd, offset, SEEK_SET); }
+
+// one entry per call like rd_readdir, leaving out . and ..
+static int benchPosixReaddir(int fd, char* address)
+{
+    struct dirent* entry;
+
+    if (fd < 0 || fd >= BENCH_POSIX_FDS)
+    {
+        return -1;
+    }
+    if (!posixDirs[fd])
+    {
+        posixDirs[fd] = fdopendir(fd);
+        if (!posixDirs[fd])
+        {
+            return -1;
+        }
+    }
+    do
+    {
+        entry = readdir(posixDirs[fd]);
+    } while (entry && (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0));
+    if (!entry)
+    {
+        return 0;
+    }
+    strncpy(address, entry->d_name, BENCH_ENTRY_SIZE - 1);
+    address[BENCH_ENTRY_SIZE - 1] = '\0';
+    return 1;
+}
+
+static int benchPosixUnlink(char* pathname) { return unlink(pathname); }
+static int benchPosixRmdir(char* pathname) { return rmdir(pathname); }
+
+static benchBackend posixBackend = {
+    "tmpfs", NULL,
+    benchPosixCreat, benchPosixMkdir, benchPosixOpen, benchPosixClose, benchPosixRead, benchPosixWrite,
+    benchPosixPread, benchPosixPwrite, benchPosixLseek, benchPosixReaddir, benchPosixUnlink, benchPosixRmdir,
+};
+
+// the operations measured; the read and write ones run once per size
+enum {
+    OP_MKDIR,
+    OP_CREAT,
+    OP_OPEN,
+    OP_CLOSE,
+    OP_LSEEK,
+    OP_READDIR,
+    OP_UNLINK,
+    OP_FIXED_COUNT
+};
+
+enum {
+    OP_WRITE_SEQ,
+    OP_READ_SEQ,
+    OP_WRITE_RAND,
+    OP_READ_RAND,
+    OP_SIZED_COUNT
+};
+
+static char* fixedOpNames[OP_FIXED_COUNT] = {
+    "mkdir", "creat", "open", "close", "lseek", "readdir", "unlink"
+};
+
+static char* sizedOpNames[OP_SIZED_COUNT] = {
+    "write_seq", "read_seq", "write_rand", "read_rand"
+};
+
+typedef struct {
+    long* samples;
+    int count;
+    int capacity;
+    int errors;
+    struct timespec start;
+    long activeNs;          // summed over the rounds of its phase
+} benchSeries;
+
+typedef struct {
+    benchBackend* backend;
+    int files;
+    int fanout;
+    int depth;
+    int threads;
+    int iterations;
+    int sizes[BENCH_MAX_LIST];
+    int sizeCount;
+    pthread_barrier_t barrier;
+} benchConfig;
+
+typedef struct {
+    benchConfig* config;
+    int id;
+    unsigned int random;
+    char* buffer;
+    benchSeries* series;   // OP_FIXED_COUNT, then OP_SIZED_COUNT per size
+} benchThread;
+
+static int seriesCount(benchConfig* config)
+{
+    return OP_FIXED_COUNT + OP_SIZED_COUNT * config->sizeCount;
+}
+
+static long nowNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static long spanNs(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000000L + (end->tv_nsec - start->tv_nsec);
+}
+
+static void addSample(benchSeries* series, long ns, int ret)
+{
+    if (ret < 0)
+    {
+        series->errors++;
+        return;
+    }
+    if (series->count == series->capacity)
+    {
+        series->capacity = series->capacity ? series->capacity * 2 : 1024;
+        series->samples = (long*) realloc(series->samples, series->capacity * sizeof(long));
+    }
+    series->samples[series->count++] = ns;
+}
+
+// times one call into the series
+#define TIMED(series, call) do {                            \
+    long timedStart = nowNs();                              \
+    int timedRet = (call);                                  \
+    addSample((series), nowNs() - timedStart, timedRet);    \
+} while (0)
+
+static unsigned int nextRandom(benchThread* thread)
+{
+    //xorshift32
+    thread->random ^= thread->random << 13;
+    thread->random ^= thread->random >> 17;
+    thread->random ^= thread->random << 5;
+    return thread->random;
+}
+
+// files sit at the leaves of a tree with fanout entries per directory:
+// the digits of the index in base fanout name the directories on the way
+static void filePath(benchThread* thread, int index, char* path)
+{
+    benchConfig* config = thread->config;
+    int digits[32];
+    int level, length;
+
+    for (level = config->depth - 1; level >= 0; level--)
+    {
+        digits[level] = index % config->fanout;
+        index /= config->fanout;
+    }
+    length = sprintf(path, "%s/t%d", config->backend->root, thread->id);
+    for (level = 0; level < config->depth - 1; level++)
+    {
+        length += sprintf(path + length, "/d%d", digits[level]);
+    }
+    sprintf(path + length, "/f%d", digits[config->depth - 1]);
+}
+
+// the directory levels above the file at index that it opens, counted up
+// from its parent; 0 when index is not the first file below any of them
+static int newDirLevels(benchConfig* config, int index)
+{
+    int levels;
+
+    levels = 0;
+    while (levels < config->depth - 1 && index % config->fanout == 0)
+    {
+        index /= config->fanout;
+        levels++;
+    }
+    return levels;
+}
+
+// cuts the last levels components off path
+static void parentPath(char* path, int levels)
+{
+    while (levels-- > 0)
+    {
+        *strrchr(path, '/') = '\0';
+    }
+}
+
+static void beginPhase(benchThread* thread, benchSeries* series)
+{
+    pthread_barrier_wait(&thread->config->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &series->start);
+}
+
+static void endPhase(benchSeries* series)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    series->activeNs += spanNs(&series->start, &end);
+}
+
+static void runMkdir(benchThread* thread)
+{
+    benchConfig* config = thread->config;
+    benchBackend* backend = config->backend;
+    benchSeries* series = &thread->series[OP_MKDIR];
+    char path[BENCH_PATH_MAX];
+    int index, levels, level;
+
+    beginPhase(thread, series);
+    sprintf(path, "%s/t%d", backend->root, thread->id);
+    TIMED(series, backend->mkdir(path));
+    for (index = 0; index < config->files; index++)
+    {
+        //a directory is made by the first file below it, outermost first
+        levels = newDirLevels(config, index);
+        for (level = levels; level > 0; level--)
+        {
+            filePath(thread, index, path);
+            parentPath(path, level);
+            TIMED(series, backend->mkdir(path));
+        }
+    }
+    endPhase(series);
+}
+
+static void runCreat(benchThread* thread)
+{
+    benchConfig* config = thread->config;
+    benchSeries* series = &thread->series[OP_CREAT];
+    char path[BENCH_PATH_MAX];
+    int index;
+
+    beginPhase(thread, series);
+    for (index = 0; index < config->files; index++)
+    {
+        filePath(thread, index, path);
+        TIMED(series, config->backend->creat(path));
+    }
+    endPhase(series);
+}
+
+// opens a batch of descriptors, then closes them, so each has rounds of
+// its own
+static void runOpenClose(benchThread* thread)
+{
+    benchConfig* config = thread->config;
+    benchBackend* backend = config->backend;
+    benchSeries* opens = &thread->series[OP_OPEN];
+    benchSeries* closes = &thread->series[OP_CLOSE];
+    char path[BENCH_PATH_MAX];
+    long started;
+    int fds[BENCH_OPEN_BATCH];
+    int done, batch, i;
+
+    for (done = 0; done < config->iterations; done += batch)
+    {
+        batch = config->iterations - done < BENCH_OPEN_BATCH ? config->iterations - done : BENCH_OPEN_BATCH;
+
+        beginPhase(thread, opens);
+        for (i = 0; i < batch; i++)
+        {
+            filePath(thread, nextRandom(thread) % config->files, path);
+            started = nowNs();
+            fds[i] = backend->open(path);
+            addSample(opens, nowNs() - started, fds[i]);
+        }
+        endPhase(opens);
+
+        beginPhase(thread, closes);
+        for (i = 0; i < batch; i++)
+        {
+            if (fds[i] >= 0)
+            {
+                TIMED(closes, backend->close(fds[i]));
+            }
+        }
+        endPhase(closes);
+    }
+}
+
+static void runData(benchThread* thread, int fd)
+{
+    benchConfig* config = thread->config;
+    benchBackend* backend = config->backend;
+    benchSeries* series;
+    int sizeIndex, size, done, position, offset;
+
+    for (sizeIndex = 0; sizeIndex < config->sizeCount; sizeIndex++)
+    {
+        size = config->sizes[sizeIndex];
+        series = &thread->series[OP_FIXED_COUNT + OP_SIZED_COUNT * sizeIndex];
+
+        //sequential passes over the whole file until enough samples
+        beginPhase(thread, &series[OP_WRITE_SEQ]);
+        for (done = 0; done < config->iterations; )
+        {
+            backend->lseek(fd, 0);
+            for (position = 0; position + size <= BENCH_DATA_SIZE; position += size, done++)
+            {
+                TIMED(&series[OP_WRITE_SEQ], backend->write(fd, thread->buffer, size));
+            }
+        }
+        endPhase(&series[OP_WRITE_SEQ]);
+
+        beginPhase(thread, &series[OP_READ_SEQ]);
+        for (done = 0; done < config->iterations; )
+        {
+            backend->lseek(fd, 0);
+            for (position = 0; position + size <= BENCH_DATA_SIZE; position += size, done++)
+            {
+                TIMED(&series[OP_READ_SEQ], backend->read(fd, thread->buffer, size));
+            }
+        }
+        endPhase(&series[OP_READ_SEQ]);
+
+        beginPhase(thread, &series[OP_WRITE_RAND]);
+        for (done = 0; done < config->iterations; done++)
+        {
+            offset = nextRandom(thread) % (BENCH_DATA_SIZE / size) * size;
+            TIMED(&series[OP_WRITE_RAND], backend->pwrite(fd, thread->buffer, size, offset));
+        }
+        endPhase(&series[OP_WRITE_RAND]);
+
+        beginPhase(thread, &series[OP_READ_RAND]);
+        for (done = 0; done < config->iterations; done++)
+        {
+            offset = nextRandom(thread) % (BENCH_DATA_SIZE / size) * size;
+            TIMED(&series[OP_READ_RAND], backend->pread(fd, thread->buffer, size, offset));
+        }
+        endPhase(&series[OP_READ_RAND]);
+    }
+
+    beginPhase(thread, &thread->series[OP_LSEEK]);
+    for (done = 0; done < config->iterations; done++)
+    {
+        TIMED(&thread->series[OP_LSEEK], backend->lseek(fd, nextRandom(thread) % BENCH_DATA_SIZE));
+    }
+    endPhase(&thread->series[OP_LSEEK]);
+}
+
+// lists every directory holding files, one readdir per entry
+static void runReaddir(benchThread* thread)
+{
+    benchConfig* config = thread->config;
+    benchBackend* backend = config->backend;
+    benchSeries* series = &thread->series[OP_READDIR];
+    char path[BENCH_PATH_MAX];
+    char entry[BENCH_ENTRY_SIZE];
+    long started;
+    int index, fd, ret;
+
+    beginPhase(thread, series);
+    for (index = 0; index < config->files; index += config->fanout)
+    {
+        filePath(thread, index, path);
+        parentPath(path, 1);
+        fd = backend->open(path);
+        if (fd < 0)
+        {
+            series->errors++;
+            continue;
+        }
+        do
+        {
+            started = nowNs();
+            ret = backend->readdir(fd, entry);
+            addSample(series, nowNs() - started, ret);
+        } while (ret > 0);
+        backend->close(fd);
+    }
+    endPhase(series);
+}
+
+// files first, then directories innermost first
+static void runUnlink(benchThread* thread)
+{
+    benchConfig* config = thread->config;
+    benchBackend* backend = config->backend;
+    benchSeries* series = &thread->series[OP_UNLINK];
+    char path[BENCH_PATH_MAX];
+    int index, levels, level;
+
+    beginPhase(thread, series);
+    for (index = 0; index < config->files; index++)
+    {
+        filePath(thread, index, path);
+        TIMED(series, backend->unlink(path));
+    }
+    for (index = config->files - 1; index >= 0; index--)
+    {
+        levels = newDirLevels(config, index);
+        for (level = 1; level <= levels; level++)
+        {
+            filePath(thread, index, path);
+            parentPath(path, level);
+            TIMED(series, backend->rmdir(path));
+        }
+    }
+    sprintf(path, "%s/t%d", backend->root, thread->id);
+    TIMED(series, backend->rmdir(path));
+    endPhase(series);
+}
+
+static void* runThread(void* arg)
+{
+    benchThread* thread = (benchThread*) arg;
+    benchBackend* backend = thread->config->backend;
+    char path[BENCH_PATH_MAX];
+    int fd;
+
+    runMkdir(thread);
+    runCreat(thread);
+    runOpenClose(thread);
+
+    //the data file is set up untimed; every thread still passes the
+    //barriers when it fails
+    sprintf(path, "%s/t%d/data", backend->root, thread->id);
+    backend->creat(path);
+    fd = backend->open(path);
+    runData(thread, fd);
+    if (fd >= 0)
+    {
+        backend->close(fd);
+    }
+    backend->unlink(path);
+
+    runReaddir(thread);
+    runUnlink(thread);
+    return NULL;
+}
+
+static int compareLong(const void* a, const void* b)
+{
+    long x = *(const long*) a;
+    long y = *(const long*) b;
+
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    char* op;
+    int size;
+    int count;
+    int errors;
+    double opsPerSec;
+    long mean;
+    long p50;
+    long p99;
+    long p999;
+} benchResult;
+
+// merges the series of every thread; a phase lasts as long as the thread
+// that spent longest in it
+static void collectResults(benchConfig* config, benchThread* threads, benchResult* results)
+{
+    benchSeries merged;
+    benchSeries* series;
+    benchResult* result;
+    long sum, wallNs;
+    int index, t, i;
+
+    for (index = 0; index < seriesCount(config); index++)
+    {
+        memset(&merged, 0, sizeof(benchSeries));
+        wallNs = 0;
+        for (t = 0; t < config->threads; t++)
+        {
+            series = &threads[t].series[index];
+            merged.samples = (long*) realloc(merged.samples, (merged.count + series->count + 1) * sizeof(long));
+            memcpy(merged.samples + merged.count, series->samples, series->count * sizeof(long));
+            merged.count += series->count;
+            merged.errors += series->errors;
+            if (series->activeNs > wallNs)
+            {
+                wallNs = series->activeNs;
+            }
+        }
+
+        result = &results[index];
+        memset(result, 0, sizeof(benchResult));
+        if (index < OP_FIXED_COUNT)
+        {
+            result->op = fixedOpNames[index];
+        }
+        else
+        {
+            result->op = sizedOpNames[(index - OP_FIXED_COUNT) % OP_SIZED_COUNT];
+            result->size = config->sizes[(index - OP_FIXED_COUNT) / OP_SIZED_COUNT];
+        }
+        result->count = merged.count;
+        result->errors = merged.errors;
+
+        if (merged.count > 0)
+        {
+            sum = 0;
+            for (i = 0; i < merged.count; i++)
+            {
+                sum += merged.samples[i];
+            }
+            qsort(merged.samples, merged.count, sizeof(long), compareLong);
+            result->mean = sum / merged.count;
+            result->p50 = merged.samples[(long) merged.count * 500 / 1000];
+            result->p99 = merged.samples[(long) merged.count * 990 / 1000];
+            result->p999 = merged.samples[(long) merged.count * 999 / 1000];
+        }
+        result->opsPerSec = wallNs > 0 ? merged.count * 1e9 / wallNs : 0;
+        free(merged.samples);
+    }
+}
+
+// works out the depth of the tree; -1 when the ramdisk cannot hold it
+static int planConfig(benchConfig* config)
+{
+    int dirs, level, width;
+
+    //levels of directories needed so no directory holds more than fanout
+    config->depth = 1;
+    for (width = config->fanout; width < config->files; width *= config->fanout)
+    {
+        config->depth++;
+    }
+    dirs = 1;
+    for (level = 1, width = config->fanout; level < config->depth; level++, width *= config->fanout)
+    {
+        dirs += (config->files + width - 1) / width;
+    }
+    if (config->threads * (config->files + dirs + 1) > BENCH_MAX_INODES || config->depth > 16)
+    {
+        fprintf(stderr, "bench: skipping %d files, fanout %d, %d threads: too many inodes\n",
+                config->files, config->fanout, config->threads);
+        return -1;
+    }
+    return 0;
+}
+
+static void runConfig(benchConfig* config, benchResult* results)
+{
+    benchThread* threads;
+    pthread_t* ids;
+    int t, index;
+
+    threads = (benchThread*) calloc(config->threads, sizeof(benchThread));
+    ids = (pthread_t*) calloc(config->threads, sizeof(pthread_t));
+    pthread_barrier_init(&config->barrier, NULL, config->threads);
+    for (t = 0; t < config->threads; t++)
+    {
+        threads[t].config = config;
+        threads[t].id = t;
+        threads[t].random = 2463534242U + t;
+        threads[t].buffer = (char*) malloc(BENCH_DATA_SIZE);
+        memset(threads[t].buffer, 'a' + t % 26, BENCH_DATA_SIZE);
+        threads[t].series = (benchSeries*) calloc(seriesCount(config), sizeof(benchSeries));
+        pthread_create(&ids[t], NULL, runThread, &threads[t]);
+    }
+    for (t = 0; t < config->threads; t++)
+    {
+        pthread_join(ids[t], NULL);
+    }
+    pthread_barrier_destroy(&config->barrier);
+
+    collectResults(config, threads, results);
+
+    for (t = 0; t < config->threads; t++)
+    {
+        for (index = 0; index < seriesCount(config); index++)
+        {
+            free(threads[t].series[index].samples);
+        }
+        free(threads[t].series);
+        free(threads[t].buffer);
+    }
+    free(threads);
+    free(ids);
+}
+
+static int outputJson;
+static int rowsPrinted;
+
+static void printResults(benchConfig* config, benchResult* results)
+{
+    benchResult* result;
+    int index;
+
+    for (index = 0; index < seriesCount(config); index++)
+    {
+        result = &results[index];
+        if (outputJson)
+        {
+            printf("%s\n  {\"backend\": \"%s\", \"op\": \"%s\", \"size\": %d, \"files\": %d, \"fanout\": %d, "
+                   "\"depth\": %d, \"threads\": %d, \"count\": %d, \"errors\": %d, \"ops_per_sec\": %.0f, "
+                   "\"mean_ns\": %ld, \"p50_ns\": %ld, \"p99_ns\": %ld, \"p999_ns\": %ld}",
+                   rowsPrinted ? "," : "[", config->backend->name, result->op, result->size,
+                   config->files, config->fanout, config->depth, config->threads, result->count,
+                   result->errors, result->opsPerSec, result->mean, result->p50, result->p99, result->p999);
+        }
+        else
+        {
+            if (!rowsPrinted)
+            {
+                printf("backend,op,size,files,fanout,depth,threads,count,errors,ops_per_sec,"
+                       "mean_ns,p50_ns,p99_ns,p999_ns\n");
+            }
+            printf("%s,%s,%d,%d,%d,%d,%d,%d,%d,%.0f,%ld,%ld,%ld,%ld\n",
+                   config->backend->name, result->op, result->size, config->files, config->fanout,
+                   config->depth, config->threads, result->count, result->errors, result->opsPerSec,
+                   result->mean, result->p50, result->p99, result->p999);
+        }
+        rowsPrinted++;
+    }
+}
+
+// one row per operation with both backends next to each other; speedup is
+// how many times more operations per second the first one managed
+static void printComparison(benchConfig* config, benchBackend** backends, benchResult** results)
+{
+    benchResult* first;
+    benchResult* second;
+    double speedup;
+    int index;
+
+    for (index = 0; index < seriesCount(config); index++)
+    {
+        first = &results[0][index];
+        second = &results[1][index];
+        speedup = second->opsPerSec > 0 ? first->opsPerSec / second->opsPerSec : 0;
+        if (outputJson)
+        {
+            printf("%s\n  {\"op\": \"%s\", \"size\": %d, \"files\": %d, \"fanout\": %d, \"depth\": %d, "
+                   "\"threads\": %d, \"speedup\": %.2f",
+                   rowsPrinted ? "," : "[", first->op, first->size, config->files, config->fanout,
+                   config->depth, config->threads, speedup);
+            printf(", \"%s\": {\"count\": %d, \"errors\": %d, \"ops_per_sec\": %.0f, \"p50_ns\": %ld, "
+                   "\"p99_ns\": %ld, \"p999_ns\": %ld}",
+                   backends[0]->name, first->count, first->errors, first->opsPerSec,
+                   first->p50, first->p99, first->p999);
+            printf(", \"%s\": {\"count\": %d, \"errors\": %d, \"ops_per_sec\": %.0f, \"p50_ns\": %ld, "
+                   "\"p99_ns\": %ld, \"p999_ns\": %ld}}",
+                   backends[1]->name, second->count, second->errors, second->opsPerSec,
+                   second->p50, second->p99, second->p999);
+        }
+        else
+        {
+            if (!rowsPrinted)
+            {
+                printf("op,size,files,fanout,depth,threads,speedup,"
+                       "%s_ops_per_sec,%s_ops_per_sec,%s_p50_ns,%s_p50_ns,%s_p99_ns,%s_p99_ns,"
+                       "%s_p999_ns,%s_p999_ns,%s_errors,%s_errors\n",
+                       backends[0]->name, backends[1]->name, backends[0]->name, backends[1]->name,
+                       backends[0]->name, backends[1]->name, backends[0]->name, backends[1]->name,
+                       backends[0]->name, backends[1]->name);
+            }
+            printf("%s,%d,%d,%d,%d,%d,%.2f,%.0f,%.0f,%ld,%ld,%ld,%ld,%ld,%ld,%d,%d\n",
+                   first->op, first->size, config->files, config->fanout, config->depth,
+                   config->threads, speedup, first->opsPerSec, second->opsPerSec,
+                   first->p50, second->p50, first->p99, second->p99, first->p999, second->p999,
+                   first->errors, second->errors);
+        }
+        rowsPrinted++;
+    }
+}
+
+// parses a comma separated list of positive numbers
+static int parseList(char* text, int* list, int maximum)
+{
+    char* token;
+    int count;
+
+    count = 0;
+    for (token = strtok(text, ","); token && count < BENCH_MAX_LIST; token = strtok(NULL, ","))
+    {
+        list[count] = atoi(token);
+        if (list[count] <= 0 || list[count] > maximum)
+        {
+            return -1;
+        }
+        count++;
+    }
+    return count;
+}
+
+static void usage(char* name)
+{
+    fprintf(stderr, "usage: %s [-n files,...] [-f fanout,...] [-t threads,...] [-s size,...] "
+            "[-i iterations] [-o csv|json] [-d tmpfs-dir]\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+    benchConfig config;
+    benchBackend* backends[2];
+    benchResult* results[2];
+    struct statfs fsInfo;
+    int files[BENCH_MAX_LIST] = { 64, 256 };
+    int fanouts[BENCH_MAX_LIST] = { 2, 8, 64 };
+    int threads[BENCH_MAX_LIST] = { 1, 2, 4 };
+    int fileCount = 2, fanoutCount = 3, threadCount = 3;
+    int backendCount = 1;
+    int n, f, t, b, option;
+
+    memset(&config, 0, sizeof(benchConfig));
+    backends[0] = &ramdiskBackend;
+    config.iterations = 10000;
+    config.sizes[0] = 256;
+    config.sizes[1] = 4096;
+    config.sizes[2] = 65536;
+    config.sizeCount = 3;
+
+    while ((option = getopt(argc, argv, "n:f:t:s:i:o:d:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                fileCount = parseList(optarg, files, BENCH_MAX_INODES);
+                break;
+            case 'f':
+                fanoutCount = parseList(optarg, fanouts, BENCH_MAX_INODES);
+                break;
+            case 't':
+                threadCount = parseList(optarg, threads, 64);
+                break;
+            case 's':
+                config.sizeCount = parseList(optarg, config.sizes, BENCH_DATA_SIZE);
+                break;
+            case 'i':
+                config.iterations = atoi(optarg);
+                break;
+            case 'o':
+                outputJson = strcmp(optarg, "json") == 0;
+                break;
+            case 'd':
+                posixBackend.root = optarg;
+                backends[1] = &posixBackend;
+                backendCount = 2;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+        if (fileCount <= 0 || fanoutCount <= 0 || threadCount <= 0 || config.sizeCount <= 0 || config.iterations <= 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    for (f = 0; f < fanoutCount; f++)
+    {
+        if (fanouts[f] < 2)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+#ifdef BENCH_IN_PROCESS
+    if (initRamdisk() < 0)
+    {
+        fprintf(stderr, "bench: cannot set up the ramdisk\n");
+        return 1;
+    }
+#else
+    deviceFd = open(DEVICE_PATH, O_RDWR);
+    if (deviceFd < 0)
+    {
+        perror("bench: " DEVICE_PATH);
+        return 1;
+    }
+#endif
+
+    //every configuration runs on each backend in turn before the next
+    if (posixBackend.root)
+    {
+        mkdir(posixBackend.root, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+        if (statfs(posixBackend.root, &fsInfo) != 0)
+        {
+            perror("bench: -d");
+            return 1;
+        }
+        if (fsInfo.f_type != TMPFS_MAGIC)
+        {
+            fprintf(stderr, "bench: %s is not on tmpfs\n", posixBackend.root);
+        }
+    }
+    for (b = 0; b < backendCount; b++)
+    {
+        results[b] = (benchResult*) calloc(OP_FIXED_COUNT + OP_SIZED_COUNT * BENCH_MAX_LIST, sizeof(benchResult));
+    }
+    for (n = 0; n < fileCount; n++)
+    {
+        for (f = 0; f < fanoutCount; f++)
+        {
+            for (t = 0; t < threadCount; t++)
+            {
+                config.files = files[n];
+                config.fanout = fanouts[f];
+                config.threads = threads[t];
+                if (planConfig(&config) == -1)
+                {
+                    continue;
+                }
+                for (b = 0; b < backendCount; b++)
+                {
+                    config.backend = backends[b];
+                    runConfig(&config, results[b]);
+                }
+                if (backendCount == 2)
+                {
+                    printComparison(&config, backends, results);
+                }
+                else
+                {
+                    printResults(&config, results[0]);
+                }
+            }
+        }
+    }
+    for (b = 0; b < backendCount; b++)
+    {
+        free(results[b]);
+    }
+    if (outputJson)
+    {
+        printf("%s]\n", rowsPrinted ? "\n" : "[");
+    }
+
+#ifdef BENCH_IN_PROCESS
+    destroyRamdisk();
+#else
+    close(deviceFd);
+#endif
+    return 0;
+}
@@ -1,49 +1,75 @@
 #ifndef RAMDISK_H
 #define RAMDISK_H
 
-#include <linux/kernel.h>
-#include <linux/init.h>
-#include <linux/module.h>
-#include <asm/unistd.h>
-#include <linux/version.h>
-#include <linux/utsname.h>
-#include <linux/string.h>
-#include <linux/sched.h>
-#include <linux/ioctl.h>
-#include <linux/errno.h>
-#include <linux/proc_fs.h>
-#include <asm/uaccess.h>
-#include <asm/string.h>
+#include "ramdisk_platform.h"
+#include "ramdisk_ioctl.h"
                                                                                                                 
 #define RAMDISK_SIZE 2097152
 #define RD_BLOCK_SIZE 256
 #define SUPERBLOCK_SIZE BLOCK_SIZE
-#define INODE_SIZE 65536
+#define INODE_SIZE (INODE_COUNT * INODE_STRUCTURE_SIZE)
 #define BLOCK_BITMAP_SIZE 1024
                                                                                                                 
 #define FREE 0
 #define ALLOCATED 1
                                                                                                                 
-#define INODE_STRUCTURE_SIZE 64
+#define INODE_STRUCTURE_SIZE ((int) sizeof(inode))    // 64 with 32-bit pointers
 #define INODE_TYPE_SIZE 4
 #define INODE_BLOCK_POINTERS 10
-#define INODE_PADDING_SIZE 6
 #define INODE_COUNT 1024
                                                                                                                 
+// block pointers in one indirect block: 64 with 32-bit pointers, 32 with
+// 64-bit ones
+#define RD_BLOCK_POINTERS ((int) (RD_BLOCK_SIZE / sizeof(char*)))
+
 #define DIRECT_SIZE 2048
-#define SINGLE_INDIRECT_SIZE 16384
-#define DOUBLE_INDIRECT_SIZE 1048576
+#define SINGLE_INDIRECT_SIZE (RD_BLOCK_POINTERS * RD_BLOCK_SIZE)
+#define DOUBLE_INDIRECT_SIZE (RD_BLOCK_POINTERS * SINGLE_INDIRECT_SIZE)
                                                                                                                 
 #define DIRECT_LIMIT 2048
-#define SINGLE_INDIRECT_LIMIT 18432
-#define DOUBLE_INDIRECT_LIMIT 1067008
+#define SINGLE_INDIRECT_LIMIT (DIRECT_LIMIT + SINGLE_INDIRECT_SIZE)
+#define DOUBLE_INDIRECT_LIMIT (SINGLE_INDIRECT_LIMIT + DOUBLE_INDIRECT_SIZE)
                                                                                                                 
 #define DIR_ENTRY_FILENAME_SIZE 14
 #define DIR_ENTRY_STRUCTURE_SIZE 16
                                                                                                                 
-#define MAX_FILE_SIZE 1067008
+#define MAX_FILE_SIZE DOUBLE_INDIRECT_LIMIT
 #define MAX_FILES_OPEN INODE_COUNT
 
+#define RD_BLOCK_COUNT ((RAMDISK_SIZE - SUPERBLOCK_SIZE - INODE_SIZE - BLOCK_BITMAP_SIZE) / RD_BLOCK_SIZE)
+#define RD_BLOCKS_PER_PAGE (PAGE_SIZE / RD_BLOCK_SIZE)
+
+#define RD_SENDFILE_CHUNK (16 * PAGE_SIZE)
+
+// inode flags
+#define INODE_FLAG_MAPPABLE 0x01    // data blocks come in page-aligned groups
+#define INODE_FLAG_UNLINKED 0x02    // out of its directory, freed on the last close
+
+// Locking: every inode has a rw_semaphore guarding its size, blocks and
+// counters, and for a directory its entries. Locks are taken in this order:
+//   mmap_sem -> directory (parent before child) -> file inode -> allocLock
+// fdListLock and allocLock are innermost spinlocks for the descriptor list
+// and for the bitmap, inode status and superblock counters. User memory is
+// never touched while an inode lock is held, since a fault on a mapped file
+// takes that inode's lock itself.
+//
+// Path lookups take no lock at all: directories are searched under
+// rcu_read_lock and validated with their sequence count, which writers bump
+// around entry changes while holding the directory write lock. Blocks taken
+// out of a directory are freed only after a grace period. Unlink bumps the
+// inode generation, so a lookup that locks what it found can tell whether
+// it is still the same file.
+//
+// The same sequence count covers the size and direct blocks of a file, so
+// files that fit in the direct blocks are read with no lock, retrying when
+// a write overlapped.
+//
+// Every change to the filesystem holds freezeLock for reading, outside all
+// of the above. Freezing takes it for writing, so no change is in flight,
+// and then publishes a path index; while it is set changes fail, and reads
+// and lookups go without locks under rcu_read_lock. Thawing clears the
+// index and waits for a grace period before changes may start again.
+
 #define TRUE 1
 #define FALSE 0
 
@@ -62,7 +88,9 @@ typedef struct {
     char type[INODE_TYPE_SIZE];
     char* location[INODE_BLOCK_POINTERS];
     short int locationCount;
-    char padding[INODE_PADDING_SIZE];
+    short int flags;
+    short int mapCount;
+    short int openCount;    // struct files opened with IOCTL_RD_OPENFILE
 } inode;
                                                                                                                 
                                                                                                                 
@@ -75,28 +103,156 @@ typedef struct {
 typedef struct {
     int filePosition;
     inode* inodePointer;
+    unsigned int generation;    // of the inode when opened, see isStaleDescriptor
 } fileDescriptorEntry;
                                                                                                                 
                                                                                                                 
+typedef struct rdAioContext_t rdAioContext;
+                                                                                                                
+                                                                                                                
 // Linked list node stored in fileDescriptorProcessList
 typedef struct fileDescriptorNode_t {
     int pid;
     fileDescriptorEntry fileDescriptorTable[MAX_FILES_OPEN];
+    inode* mmapInode;    // file selected for the next mmap of the device, pinned by mapCount
+    rd_ring* ring;       // submission/completion ring, if set up
+    rdAioContext* aio;   // async requests, if set up
     struct fileDescriptorNode_t* next;
 } fileDescriptorNode;
                                                                                                                 
                                                                                                                 
+// directory blocks waiting for an RCU grace period before they are freed
+#define RD_RETIRED_MAX 8
+
 typedef struct {
-    char* pointers[64];
+    char* blocks[RD_RETIRED_MAX];
+    int count;
+} retiredBlocks;
+
+
+// seeds tried per bucket, and salts tried before a freeze gives up
+#define RD_INDEX_SEEDS 4096
+#define RD_INDEX_SALTS 8
+
+// One path of a frozen filesystem; paths are stored without a trailing slash
+typedef struct {
+    int inodeNumber;
+    int parent;         // entry of the containing directory, -1 for the root
+    char* name;         // its directory entry
+    int offset;         // of the path in pathIndex.paths
+    int length;
+    unsigned int hash;
+    int next;           // next entry in the same bucket while building
+} pathEntry;
+
+// Minimal perfect hash from path to inode, built when the filesystem is
+// frozen: a path hashes to a bucket, and the bucket's seed places it in a
+// slot no other path uses
+typedef struct {
+    unsigned int salt;
+    unsigned int bucketCount;   // powers of two
+    unsigned int slotCount;
+    unsigned int* seeds;
+    int* slots;                 // entry in each slot, -1 if empty
+    pathEntry* entries;
+    int entryCount;
+    char* paths;
+} pathIndex;
+
+
+typedef struct {
+    char* pointers[RD_BLOCK_POINTERS];
 } singleIndirectLevel;
                                                                                                                 
                                                                                                                 
 typedef struct {
-    singleIndirectLevel* pointers[64];
+    singleIndirectLevel* pointers[RD_BLOCK_POINTERS];
 } doubleIndirectLevel;
 
 
 
+// Space report: histograms have log2 buckets, bucket b counting values in
+// [2^b, 2^(b+1)) and the last one everything larger
+#define RD_SPACE_BUCKETS 16
+
+// bytes a file could keep in its inode, in place of the block pointers
+#define RD_INLINE_SIZE ((int) (INODE_BLOCK_POINTERS * sizeof(char*)))
+
+typedef struct {
+    int totalBlocks;
+    int freeBlocks;
+    int freeExtents;
+    int largestFreeExtent;
+    int freeExtentSizes[RD_SPACE_BUCKETS];      // runs of free blocks by length
+    int files;
+    int directories;
+    int fileExtents;
+    int mostFileExtents;
+    int fileExtentCounts[RD_SPACE_BUCKETS];     // files by number of extents
+    int fileDataBlocks;
+    int fileIndexBlocks;                        // indirect blocks of files
+    int directoryDataBlocks;
+    int directoryIndexBlocks;
+    int inlineFiles;                            // files of RD_INLINE_SIZE or less
+} spaceReport;
+
+
+// Statistics: per-cpu counters, summed when /proc/ramdisk_stats is read
+enum {
+    RD_STAT_CREAT,
+    RD_STAT_MKDIR,
+    RD_STAT_OPEN,
+    RD_STAT_CLOSE,
+    RD_STAT_READ,
+    RD_STAT_WRITE,
+    RD_STAT_LSEEK,
+    RD_STAT_UNLINK,
+    RD_STAT_READDIR,
+    RD_STAT_MMAP,
+    RD_STAT_READFILE,
+    RD_STAT_WRITEFILE,
+    RD_STAT_OPENFILE,
+    RD_STAT_FREEZE,
+    RD_STAT_THAW,
+    RD_STAT_BYTES_READ,
+    RD_STAT_BYTES_WRITTEN,
+    RD_STAT_ERR_NOENT,          // no such file or directory
+    RD_STAT_ERR_EXIST,          // already exists
+    RD_STAT_ERR_NOSPC,          // out of blocks or inodes
+    RD_STAT_ERR_MFILE,          // descriptor table full
+    RD_STAT_ERR_BADF,           // bad file descriptor
+    RD_STAT_ERR_ROFS,           // frozen
+    RD_STAT_ERR_BUSY,           // directory not empty or file open
+    RD_STAT_COUNT
+};
+
+typedef struct {
+    unsigned long values[RD_STAT_COUNT];
+} rdStatCounters;
+
+DECLARE_PER_CPU(rdStatCounters, rdStats);
+
+#define rdStatAdd(counter, amount) this_cpu_add(rdStats.values[counter], (amount))
+#define rdStatInc(counter) this_cpu_inc(rdStats.values[counter])
+
+// per-operation messages, only built with -DRD_DEBUG; in userspace they go
+// straight to stderr, RD_VERBOSE or not
+#if defined(RD_DEBUG) && defined(__KERNEL__)
+#define rdDebug(...) printk(KERN_DEBUG __VA_ARGS__)
+#elif defined(RD_DEBUG)
+#define rdDebug(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define rdDebug(...) do { } while (0)
+#endif
+
+
+// The filesystem, shared with the module glue in ramdisk_kmod.c
+extern char* ramdisk;
+extern superblock* sb;
+extern inode* inodeArray;
+extern fileDescriptorNode* fileDescriptorProcessList;
+extern const char* rdStatNames[RD_STAT_COUNT];
+
 unsigned int bitPosition(unsigned int index);
 unsigned int getBit(unsigned int* value, int bitPosition);
 void setBit(unsigned int* value, int bitPosition);
@@ -106,45 +262,95 @@ int getMin(int a, int b);
 // Initialization
 void initBlockBitmap(void);
 void initInodeArray(void);
+void lockInode(int inodeNumber, int exclusive);
+void unlockInode(int inodeNumber, int exclusive);
+void beginInodeChange(inode* node);
+void endInodeChange(inode* node);
+int beginMutation(void);
+void endMutation(void);
 int initRamdisk(void);
 void destroyRamdisk(void);
                                                                                                                 
 void initFileDescriptorTable(void);
 fileDescriptorNode* findFileDescriptor(fileDescriptorNode* trav, int pid);
 int getFileDescriptorIndex(fileDescriptorNode* pointer);
+fileDescriptorNode* getFileDescriptorNode(int pid);
 int createFileDescriptor(int pid, int inodeNumber);
+void unselectMapping(fileDescriptorNode* node);
+unsigned long rdStatSum(int counter);
+int rdDescriptorInode(int fd);
+int rdDescriptorPosition(int fd);
+void rdDescriptorCounts(int* processes, int* descriptors);
 
 // Helper functions                                                                                                                
-void printBlockBitmap(void);
+void analyzeSpace(spaceReport* report);
 char* getFreeBlock(void);
-void parse(char* pathname, char** parents, char** fileName);
+char* getFreeBlockGroup(void);
+void freeBlockGroup(char* groupAddress);
+int parse(char* pathname, char** parents, char** fileName);
+char* allocPath(void);
+void freePath(char* path);
 void setBitmap(char* blockPointer);
+char* getDataBlock(inode* node, int blockIndex);
 char* allocateBlock(inode* node);
+void freeInodeBlocks(inode* node);
+int relocateToBlockGroups(inode* node);
+int truncateInode(inode* node);
 int existsInBlock(char* blockAddress, char* fileName, char* type);
 int getLastEntry(char* blockAddress, char** lastEntry);
 char* scanBlockForFreeSlot(char* blockAddress);
-char* findLastEntry(int inodeNumber);
-int deleteFromBlock(char* blockAddress, char* fileName, char* type, int parentInodeNumber);
+char* findLastEntry(int inodeNumber, retiredBlocks* retired);
+int deleteFromBlock(char* blockAddress, char* fileName, char* type, int parentInodeNumber, retiredBlocks* retired);
+void retireBlock(retiredBlocks* retired, char* blockPointer);
+void freeRetiredBlocks(retiredBlocks* retired);
 int isDirEntry(int inodeNumber, char* fileName, char* type);
-int unlinkHelper(int inodeNumber, char* fileName, char* type);
-int getDirInodeNumber(char* pathname);
+int unlinkHelper(int inodeNumber, char* fileName, char* type, retiredBlocks* retired);
+int unlinkFromDir(int parentInodeNum, char* fileName, int deferOpen);
+void freeUnlinkedInode(int inodeNumber);
+int lookupDir(char* pathname, unsigned int* generation);
+int lookupPath(char* pathname, char* type, unsigned int* generation);
+unsigned int inodeGeneration(int inodeNumber);
+int isStaleDescriptor(fileDescriptorEntry* entry);
+int getDirInodeNumber(char* pathname, int exclusive);
+int lockPathInode(char* pathname, char* type, int exclusive);
 int validateFile(char* pathname, char* type);
+int getInodeNumber(char* pathname, char* type, int* parentInodeNum, int exclusive);
+pathIndex* buildPathIndex(void);
+void freePathIndex(pathIndex* index);
+int lookupFrozenPath(pathIndex* index, char* pathname, char* type);
 dirEntry* getFreeDirEntry(int inodeNumber);
 int mapFilepositionToMemAddr(inode* pointer, int filePosition, char** filePositionAddress);
+int countFileExtents(inode* node);
 int findFileDescriptorIndexByPathname(fileDescriptorNode* pointer, char* pathname);
 int isFileInFDProcessList(char* inodePointer);
+int readFromInode(inode* inodePointer, int position, char* address, int num_bytes);
+int readSmallInode(inode* inodePointer, int position, char* address, int num_bytes, int* fileSize);
+int readFrozenInode(inode* inodePointer, int position, char* address, int num_bytes);
+int writeInodeRange(inode* inodePointer, int position, char* address, int num_bytes);
+int writeToInode(inode* inodePointer, int position, char* address, int num_bytes);
  
 // File operations
-int create(char* pathname, char* type);
+int createInDir(int parentInodeNum, char* fileName, char* type);
+int create(char* pathname, char* type, int* inodeNumber);
 int ram_creat(char* pathname);
 int ram_mkdir(char* pathname);
 int ram_open(char* pathname);
 int ram_close(int fd);
 int ram_read(int fd, char* address, int num_bytes);
 int ram_write(int fd, char *address, int num_bytes);
+int ram_pread(int fd, char* address, int num_bytes, int offset);
+int ram_pwrite(int fd, char* address, int num_bytes, int offset);
 int ram_lseek(int fd, int offset);
 int ram_unlink(char* pathname);
 int ram_readdir(int fd, char* address);
+int ram_mmap(int fd);
+int ram_readfile(char* pathname, char* address, int num_bytes);
+int ram_writefile(char* pathname, char* address, int num_bytes);
+int ram_openfile(char* pathname);
+int ram_freeze(void);
+int ram_thaw(void);
+int isFrozen(void);
+int holdFreeze(void);
+void releaseFreeze(void);
 
-int getpid(void);
 #endif
@@ -0,0 +1,3752 @@
+#include "ramdisk.h"
+#include "ramdisk_trace.h"
+
+
+char* ramdisk;                                            //the starting pointer
+superblock* sb;                                           //superblock
+inode* inodeArray;                                        //inode
+fileDescriptorNode* fileDescriptorProcessList;            //file descriptor
+static struct kmem_cache* pathCache;                      //RD_PATH_MAX path buffers
+static struct rw_semaphore inodeLocks[INODE_COUNT];       //data and entry lock of each inode
+static seqcount_t inodeSeqs[INODE_COUNT];                 //bumped around directory entry changes
+static unsigned int inodeGenerations[INODE_COUNT];        //bumped when an inode is unlinked
+static DEFINE_SPINLOCK(allocLock);                        //bitmap, inode status, superblock counters
+static DEFINE_SPINLOCK(fdListLock);                       //insertions into fileDescriptorProcessList
+static DECLARE_RWSEM(freezeLock);                         //read by changes, written to freeze and thaw
+static pathIndex* frozenIndex;                            //path index, set while frozen
+static int explicitFreeze;                                //frozen by ram_freeze, until ram_thaw
+static int freezeHolders;                                 //open backup images, see holdFreeze
+DEFINE_PER_CPU(rdStatCounters, rdStats);                  //operation and error counts
+
+const char* rdStatNames[RD_STAT_COUNT] = {
+    "creat", "mkdir", "open", "close", "read", "write", "lseek", "unlink",
+    "readdir", "mmap", "readfile", "writefile", "openfile", "freeze", "thaw",
+    "bytes_read", "bytes_written",
+    "err_noent", "err_exist", "err_nospc", "err_mfile", "err_badf", "err_rofs", "err_busy"
+};
+
+#ifndef __KERNEL__
+pthread_rwlock_t rdRcuLock = PTHREAD_RWLOCK_INITIALIZER;  //see rcu_read_lock
+#endif
+
+//management of bitmap section
+//
+//determine the position of bit
+unsigned int bitPosition(unsigned int index) 
+{
+    return (0x01 << index);
+}
+
+//get the value of bit
+unsigned int getBit(unsigned int* value, int bitPosition) 
+{
+    return (*value & bitPosition);
+}
+
+//set the value of bit
+void setBit(unsigned int* value, int bitPosition) 
+{
+    *value |= bitPosition;
+}
+
+//cleat the bit
+void clearBit(unsigned int* value, int bitPosition) 
+{
+    *value &= ~(bitPosition);
+}
+
+
+int getMin(int a, int b) 
+{
+        if (a <= b) 
+        {
+            return a;
+        }
+        else           
+        {
+            return b;
+        }
+}
+
+
+//bitmap
+void initBlockBitmap(void) 
+{
+    char* blockBitmapIter;
+    int i;
+    blockBitmapIter = sb->blockBitmapStart;
+    for (i = 0; i < BLOCK_BITMAP_SIZE; i++) 
+    {
+        *blockBitmapIter = FREE;
+        blockBitmapIter++;
+    }
+}
+
+//management of blocks
+char* getFreeBlock(void) 
+{
+    int bitNumber;
+    int byteNumber;
+    int blockNumber;
+    unsigned int freeBlocks;
+    char* blockAddress;
+
+    spin_lock(&allocLock);
+    for (byteNumber = 0; byteNumber < BLOCK_BITMAP_SIZE; byteNumber++) 
+    {
+        for (bitNumber = 0; bitNumber < 8; bitNumber++) 
+        {
+            if (getBit((unsigned int *)(byteNumber + sb->blockBitmapStart), bitPosition(bitNumber)) == FREE) 
+            {
+                blockNumber = (byteNumber * 8) + bitNumber;
+                if (blockNumber >= RD_BLOCK_COUNT) 
+                {
+                    spin_unlock(&allocLock);
+                    rdStatInc(RD_STAT_ERR_NOSPC);
+                    return NULL;
+                }
+                sb->freeBlocks--;
+                freeBlocks = sb->freeBlocks;
+                setBit((unsigned int *)(sb->blockBitmapStart + byteNumber), bitPosition(bitNumber));
+                spin_unlock(&allocLock);
+                trace_ramdisk_alloc_block(blockNumber, 1, freeBlocks);
+
+                //the block is ours now, clear it outside the lock
+                blockAddress = sb->freeBlockStart + (RD_BLOCK_SIZE * blockNumber);  
+                memset(blockAddress, 0, RD_BLOCK_SIZE);
+                return blockAddress;         
+            }             
+        }
+    }
+    spin_unlock(&allocLock);
+    rdStatInc(RD_STAT_ERR_NOSPC);
+
+    return NULL;
+}
+
+//reserves RD_BLOCKS_PER_PAGE contiguous blocks starting on a page boundary,
+//so every page of a mapped file is backed by a single page of the ramdisk
+char* getFreeBlockGroup(void) 
+{
+    int firstBlock;
+    int blockNumber;
+    int i;
+    unsigned int freeBlocks;
+    char* groupAddress;
+
+    firstBlock = ((PAGE_SIZE - offset_in_page(sb->freeBlockStart)) % PAGE_SIZE) / RD_BLOCK_SIZE;
+
+    spin_lock(&allocLock);
+    for (blockNumber = firstBlock; blockNumber + RD_BLOCKS_PER_PAGE <= RD_BLOCK_COUNT; blockNumber += RD_BLOCKS_PER_PAGE) 
+    {
+        for (i = 0; i < RD_BLOCKS_PER_PAGE; i++) 
+        {
+            if (getBit((unsigned int *)(sb->blockBitmapStart + (blockNumber + i) / 8), bitPosition((blockNumber + i) % 8)) != FREE) 
+            {
+                break;
+            }
+        }
+
+        if (i < RD_BLOCKS_PER_PAGE) 
+        {
+            continue;
+        }
+
+        for (i = 0; i < RD_BLOCKS_PER_PAGE; i++) 
+        {
+            setBit((unsigned int *)(sb->blockBitmapStart + (blockNumber + i) / 8), bitPosition((blockNumber + i) % 8));
+        }
+        sb->freeBlocks -= RD_BLOCKS_PER_PAGE;
+        freeBlocks = sb->freeBlocks;
+        spin_unlock(&allocLock);
+        trace_ramdisk_alloc_block(blockNumber, RD_BLOCKS_PER_PAGE, freeBlocks);
+
+        groupAddress = sb->freeBlockStart + (RD_BLOCK_SIZE * blockNumber);
+        memset(groupAddress, 0, PAGE_SIZE);
+        return groupAddress;
+    }
+    spin_unlock(&allocLock);
+    rdStatInc(RD_STAT_ERR_NOSPC);
+
+    return NULL;
+}
+
+//returns a whole block group to the bitmap
+void freeBlockGroup(char* groupAddress) 
+{
+    int i;
+    for (i = 0; i < RD_BLOCKS_PER_PAGE; i++) 
+    {
+        setBitmap(groupAddress + (RD_BLOCK_SIZE * i));
+    }
+}
+
+//log2 bucket of a histogram of RD_SPACE_BUCKETS
+static int spaceBucket(int value) 
+{
+    int bucket;
+
+    for (bucket = 0; value > 1 && bucket < RD_SPACE_BUCKETS - 1; bucket++) 
+    {
+        value >>= 1;
+    }
+    return bucket;
+}
+
+//runs of free blocks in the bitmap
+static void analyzeFreeSpace(spaceReport* report) 
+{
+    int blockNumber, run;
+
+    run = 0;
+    spin_lock(&allocLock);
+    for (blockNumber = 0; blockNumber <= RD_BLOCK_COUNT; blockNumber++) 
+    {
+        if (blockNumber < RD_BLOCK_COUNT && 
+            getBit((unsigned int *)(sb->blockBitmapStart + blockNumber / 8), bitPosition(blockNumber % 8)) == FREE) 
+        {
+            run++;
+            continue;
+        }
+        if (run > 0) 
+        {
+            report->freeBlocks += run;
+            report->freeExtents++;
+            report->freeExtentSizes[spaceBucket(run)]++;
+            if (run > report->largestFreeExtent) 
+            {
+                report->largestFreeExtent = run;
+            }
+            run = 0;
+        }
+    }
+    spin_unlock(&allocLock);
+}
+
+//blocks held by an inode, split into data and indirect blocks; the caller
+//holds the inode locked
+static void countInodeBlocks(inode* node, int* dataBlocks, int* indexBlocks) 
+{
+    int i, j;
+    singleIndirectLevel* singleIndirectBlock;
+    doubleIndirectLevel* doubleIndirectBlock;
+
+    *dataBlocks = *indexBlocks = 0;
+    for (i = 0; i < getMin(node->locationCount, 8) && node->location[i]; i++) 
+    {
+        (*dataBlocks)++;
+    }
+
+    if (node->locationCount > 8) 
+    {
+        singleIndirectBlock = (singleIndirectLevel*) node->location[8];
+        (*indexBlocks)++;
+        for (i = 0; i < RD_BLOCK_POINTERS && singleIndirectBlock->pointers[i]; i++) 
+        {
+            (*dataBlocks)++;
+        }
+    }
+
+    if (node->locationCount == 10) 
+    {
+        doubleIndirectBlock = (doubleIndirectLevel*) node->location[9];
+        (*indexBlocks)++;
+        for (i = 0; i < RD_BLOCK_POINTERS && doubleIndirectBlock->pointers[i]; i++) 
+        {
+            singleIndirectBlock = doubleIndirectBlock->pointers[i];
+            (*indexBlocks)++;
+            for (j = 0; j < RD_BLOCK_POINTERS && singleIndirectBlock->pointers[j]; j++) 
+            {
+                (*dataBlocks)++;
+            }
+        }
+    }
+
+    //mapped files hold their data in whole groups
+    if (node->flags & INODE_FLAG_MAPPABLE) 
+    {
+        *dataBlocks = (*dataBlocks + RD_BLOCKS_PER_PAGE - 1) / RD_BLOCKS_PER_PAGE * RD_BLOCKS_PER_PAGE;
+    }
+}
+
+//fills report with the free space of the bitmap and the blocks of every
+//inode; each inode is locked while it is counted, so the report is
+//consistent per file but not across files
+void analyzeSpace(spaceReport* report) 
+{
+    inode* node;
+    int i, extents, dataBlocks, indexBlocks;
+
+    memset(report, 0, sizeof(spaceReport));
+    report->totalBlocks = RD_BLOCK_COUNT;
+    analyzeFreeSpace(report);
+
+    for (i = 0; i < INODE_COUNT; i++) 
+    {
+        node = &inodeArray[i];
+        if (ACCESS_ONCE(node->status) != ALLOCATED) 
+        {
+            continue;
+        }
+
+        lockInode(i, FALSE);
+        if (node->status != ALLOCATED || node->locationCount == 0) 
+        {
+            unlockInode(i, FALSE);
+            continue;
+        }
+
+        countInodeBlocks(node, &dataBlocks, &indexBlocks);
+        if (strcmp(node->type, "dir") == 0) 
+        {
+            report->directories++;
+            report->directoryDataBlocks += dataBlocks;
+            report->directoryIndexBlocks += indexBlocks;
+        }
+        else if (strcmp(node->type, "reg") == 0) 
+        {
+            report->files++;
+            report->fileDataBlocks += dataBlocks;
+            report->fileIndexBlocks += indexBlocks;
+            if (node->size <= RD_INLINE_SIZE) 
+            {
+                report->inlineFiles++;
+            }
+
+            extents = countFileExtents(node);
+            report->fileExtents += extents;
+            if (extents > 0) 
+            {
+                report->fileExtentCounts[spaceBucket(extents)]++;
+            }
+            if (extents > report->mostFileExtents) 
+            {
+                report->mostFileExtents = extents;
+            }
+        }
+        unlockInode(i, FALSE);
+    }
+}
+
+//management of inodes      
+void initInodeArray(void) {
+    int i, j;
+    for (i = 0; i < INODE_COUNT; i++) 
+    {
+        inodeArray[i].inodeNumber = i;
+        inodeArray[i].status = FREE;
+        strcpy(inodeArray[i].type, "nul");
+        inodeArray[i].size = 0;
+        for (j = 0; j < INODE_BLOCK_POINTERS; j++) 
+        {     
+            inodeArray[i].location[j] = NULL;
+        }
+        inodeArray[i].locationCount = 0;
+        inodeArray[i].flags = 0;
+        inodeArray[i].mapCount = 0;
+        inodeArray[i].openCount = 0;
+        init_rwsem(&inodeLocks[i]);
+        seqcount_init(&inodeSeqs[i]);
+        inodeGenerations[i] = 0;
+    }
+}
+
+//takes the lock of inode inodeNumber, for writing if exclusive is set
+void lockInode(int inodeNumber, int exclusive) 
+{
+    if (exclusive) 
+    {
+        down_write(&inodeLocks[inodeNumber]);
+    }
+    else 
+    {
+        down_read(&inodeLocks[inodeNumber]);
+    }
+}
+
+void unlockInode(int inodeNumber, int exclusive) 
+{
+    if (exclusive) 
+    {
+        up_write(&inodeLocks[inodeNumber]);
+    }
+    else 
+    {
+        up_read(&inodeLocks[inodeNumber]);
+    }
+}
+
+//brackets a change that lockless readers must not see half done: the
+//entries of a directory, or the size and direct blocks of a file; the
+//inode is write locked and nothing in between may sleep
+void beginInodeChange(inode* node) 
+{
+    preempt_disable();
+    write_seqcount_begin(&inodeSeqs[node->inodeNumber]);
+}
+
+void endInodeChange(inode* node) 
+{
+    write_seqcount_end(&inodeSeqs[node->inodeNumber]);
+    preempt_enable();
+}
+
+//brackets every change to the filesystem, outside any inode lock; fails
+//while the filesystem is frozen
+int beginMutation(void) 
+{
+    down_read(&freezeLock);
+    if (frozenIndex) 
+    {
+        up_read(&freezeLock);
+        rdStatInc(RD_STAT_ERR_ROFS);
+        return -1;
+    }
+    return 0;
+}
+
+void endMutation(void) 
+{
+    up_read(&freezeLock);
+}
+
+
+//initializes the ramdisk, allocates 2MB memory and sets up all the starting pointers of all section
+int initRamdisk(void) 
+{
+    //all starting pointers
+    char* superblockStart;
+    char* inodeArrayStart;
+    char* blockBitmapStart;
+    char* freeBlockStart;
+    int freeBlocks, freeInodes;
+    
+    pathCache = kmem_cache_create("ramdisk_path", RD_PATH_MAX, 0, 0, NULL);
+    if (!pathCache) 
+    {
+        return -1;
+    }
+
+    //alloctes 2MB memory to the ramdisk
+    ramdisk = (void*) vmalloc(RAMDISK_SIZE);
+    if (!ramdisk) 
+    {
+        printk("There is no memory for ramdisk.\n");
+        return -1;
+    }
+
+    superblockStart = ramdisk;
+    inodeArrayStart = superblockStart + SUPERBLOCK_SIZE; 
+    blockBitmapStart = inodeArrayStart + INODE_SIZE;
+    freeBlockStart = blockBitmapStart + BLOCK_BITMAP_SIZE;
+    
+    //calculates the number of free blocks and inodes
+    freeBlocks = (RAMDISK_SIZE - SUPERBLOCK_SIZE - INODE_SIZE - BLOCK_BITMAP_SIZE) / RD_BLOCK_SIZE;
+    freeInodes = INODE_SIZE / INODE_STRUCTURE_SIZE;
+    
+
+    sb = (superblock*)superblockStart;
+    sb->freeBlocks = freeBlocks;
+    sb->freeInodes = freeInodes - 1;// the root
+    sb->blockBitmapStart = blockBitmapStart;
+    sb->freeBlockStart = freeBlockStart;
+
+    inodeArray = (inode*)inodeArrayStart;
+    initBlockBitmap();
+    initInodeArray();
+
+    inodeArray[0].inodeNumber = 0;
+    inodeArray[0].status = ALLOCATED;
+    strcpy(inodeArray[0].type, "dir");
+    inodeArray[0].size = 0;
+    inodeArray[0].location[0] = getFreeBlock();
+    inodeArray[0].locationCount++;
+    return 1;
+}
+
+//free the ramdisk
+void destroyRamdisk(void) 
+{
+    fileDescriptorNode* fdNode;
+
+    if (ramdisk) {
+        vfree(ramdisk);
+    }
+    while (fileDescriptorProcessList) {
+        fdNode = fileDescriptorProcessList;
+        fileDescriptorProcessList = fdNode->next;
+        if (fdNode->ring) {
+            vfree(fdNode->ring);
+        }
+        vfree(fdNode);
+    }
+    if (frozenIndex) 
+    {
+        freePathIndex(frozenIndex);
+        frozenIndex = NULL;
+    }
+    explicitFreeze = 0;
+    freezeHolders = 0;
+    if (pathCache) 
+    {
+        kmem_cache_destroy(pathCache);
+        pathCache = NULL;
+    }
+    ramdisk = NULL;
+    sb = NULL;
+    inodeArray = NULL;
+}
+
+//sets up and initializes the file descriptor
+void initFileDescriptorTable(void) 
+{
+    fileDescriptorNode* dumramHead;
+    dumramHead = (fileDescriptorNode*) vmalloc(sizeof(fileDescriptorNode));
+    dumramHead->pid = 0;
+    dumramHead->mmapInode = NULL;
+    dumramHead->ring = NULL;
+    dumramHead->aio = NULL;
+    dumramHead->next = NULL;
+    fileDescriptorProcessList = dumramHead;
+}
+
+//
+fileDescriptorNode* findFileDescriptor(fileDescriptorNode* trav, int pid) 
+{
+    while (trav) 
+    {
+        if (trav->pid == pid) 
+        {
+            return trav;
+        }
+        trav = trav->next;
+    }
+    return NULL;
+}
+
+//gets the index of file descriptor
+int getFileDescriptorIndex(fileDescriptorNode* pointer) 
+{
+    int i;
+    for (i = 0; i < MAX_FILES_OPEN; i++) 
+    {
+        if (pointer->fileDescriptorTable[i].filePosition == -1)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//finds the descriptor table of pid, adding an empty one if it has none yet;
+//tables are only ever added at the head and freed at module exit, so lookups
+//walk the list without a lock
+fileDescriptorNode* getFileDescriptorNode(int pid) 
+{
+    fileDescriptorNode* newEntry;
+    fileDescriptorNode* existing;
+    int i;
+
+    newEntry = findFileDescriptor(fileDescriptorProcessList, pid);
+    if (newEntry != NULL) 
+    {
+        return newEntry;
+    }
+
+    newEntry = (fileDescriptorNode*) vmalloc(sizeof(fileDescriptorNode));
+    if (newEntry == NULL) 
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < MAX_FILES_OPEN; i++) 
+    {
+        newEntry->fileDescriptorTable[i].filePosition = -1;
+        newEntry->fileDescriptorTable[i].inodePointer = NULL;
+    }
+
+    newEntry->pid = pid;
+    newEntry->mmapInode = NULL;
+    newEntry->ring = NULL;
+    newEntry->aio = NULL;
+
+    spin_lock(&fdListLock);
+    existing = findFileDescriptor(fileDescriptorProcessList, pid);
+    if (existing != NULL) 
+    {
+        spin_unlock(&fdListLock);
+        vfree(newEntry);
+        return existing;
+    }
+    newEntry->next = fileDescriptorProcessList;
+    //the table must be complete before other cpus can reach it
+    smp_wmb();
+    fileDescriptorProcessList = newEntry;
+    spin_unlock(&fdListLock);
+    trace_ramdisk_fd_table(pid);
+
+    return newEntry;
+}
+
+//drops the file selected for the next mmap and the pin it holds
+void unselectMapping(fileDescriptorNode* node) 
+{
+    inode* selected;
+
+    selected = node->mmapInode;
+    if (selected == NULL) 
+    {
+        return;
+    }
+    node->mmapInode = NULL;
+    lockInode(selected->inodeNumber, TRUE);
+    selected->mapCount--;
+    unlockInode(selected->inodeNumber, TRUE);
+}
+
+//create the file descriptor
+int createFileDescriptor(int pid, int inodeNumber) 
+{
+    fileDescriptorNode* check;
+    int fd;
+
+    check = getFileDescriptorNode(pid);
+    if (check == NULL) 
+    {
+        return -1;
+    }
+
+    fd = getFileDescriptorIndex(check);
+    if (fd == -1) 
+    {
+        return -1;
+    }
+
+    check->fileDescriptorTable[fd].inodePointer = &inodeArray[inodeNumber];
+    check->fileDescriptorTable[fd].filePosition = 0;
+    check->fileDescriptorTable[fd].generation = ACCESS_ONCE(inodeGenerations[inodeNumber]);
+
+    return fd;
+}
+
+//whether the file behind a descriptor was unlinked since it was opened, so
+//its inode may belong to another file by now; the generation only changes
+//under the inode write lock, lockless readers check again after the copy
+int isStaleDescriptor(fileDescriptorEntry* entry) 
+{
+    return ACCESS_ONCE(inodeGenerations[entry->inodePointer->inodeNumber]) != entry->generation;
+}
+
+//total of one counter over all cpus
+unsigned long rdStatSum(int counter) 
+{
+    unsigned long sum;
+    int cpu;
+
+    sum = 0;
+    for_each_possible_cpu(cpu) 
+    {
+        sum += per_cpu(rdStats, cpu).values[counter];
+    }
+    return sum;
+}
+
+//inode behind fd of the calling task, -1 if fd is not open
+int rdDescriptorInode(int fd) 
+{
+    fileDescriptorNode* node;
+    inode* inodePointer;
+
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        return -1;
+    }
+    node = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (node == NULL) 
+    {
+        return -1;
+    }
+    inodePointer = ACCESS_ONCE(node->fileDescriptorTable[fd].inodePointer);
+    return inodePointer ? inodePointer->inodeNumber : -1;
+}
+
+//inode behind fd for the operation tracepoints, looked up only while one
+//of them is enabled
+static inline int traceInode(int fd) 
+{
+    if (!trace_ramdisk_op_enter_enabled() && !trace_ramdisk_op_exit_enabled()) 
+    {
+        return -1;
+    }
+    return rdDescriptorInode(fd);
+}
+
+//position of fd of the calling task, -1 if fd is not open
+int rdDescriptorPosition(int fd) 
+{
+    fileDescriptorNode* node;
+
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        return -1;
+    }
+    node = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (node == NULL) 
+    {
+        return -1;
+    }
+    return node->fileDescriptorTable[fd].filePosition;
+}
+
+//counts descriptor tables and the descriptors open in them; the tables
+//are walked without a lock like any lookup, so the counts are a snapshot
+void rdDescriptorCounts(int* processes, int* descriptors) 
+{
+    fileDescriptorNode* trav;
+    int i;
+
+    *processes = *descriptors = 0;
+    for (trav = fileDescriptorProcessList; trav; trav = trav->next) 
+    {
+        (*processes)++;
+        for (i = 0; i < MAX_FILES_OPEN; i++) 
+        {
+            if (trav->fileDescriptorTable[i].inodePointer != NULL) 
+            {
+                (*descriptors)++;
+            }
+        }
+    }
+}
+
+//one RD_PATH_MAX path buffer, release with freePath
+char* allocPath(void) 
+{
+    return (char*) kmem_cache_alloc(pathCache, GFP_KERNEL);
+}
+
+//copies pathname into one path buffer and splits it in place at the last
+//slash; parents and fileName both point into it, release with freePath(parents)
+int parse(char* pathname, char** parents, char** fileName) 
+{
+    char* copyPathname;
+    char* lastSlash;
+
+    copyPathname = allocPath();
+    if (!copyPathname) 
+    {
+        return -1;
+    }
+    strscpy(copyPathname, pathname, RD_PATH_MAX);
+
+    lastSlash = strrchr(copyPathname, '/');
+    if (!lastSlash) 
+    {
+        kmem_cache_free(pathCache, copyPathname);
+        return -1;
+    }
+    *lastSlash = '\0';
+
+    *parents = copyPathname;
+    *fileName = lastSlash + 1;
+    return 0;
+}
+
+//path buffers from allocPath() and parse()
+void freePath(char* path) 
+{
+    kmem_cache_free(pathCache, path);
+}
+
+void setBitmap(char* blockPointer) {
+    int blockNumber;
+    int bitmapByteIndex;
+    int bitmapBitIndex;
+    unsigned int freeBlocks;
+    char* positionInBitmap;
+
+    blockNumber = ((blockPointer - sb->freeBlockStart) / RD_BLOCK_SIZE);
+
+    bitmapByteIndex = blockNumber / 8;
+    bitmapBitIndex  = blockNumber % 8;
+
+    positionInBitmap = sb->blockBitmapStart + bitmapByteIndex;
+
+    spin_lock(&allocLock);
+    sb->freeBlocks++;
+    freeBlocks = sb->freeBlocks;
+    clearBit((unsigned int*)positionInBitmap, bitPosition(bitmapBitIndex));
+    spin_unlock(&allocLock);
+    trace_ramdisk_free_block(blockNumber, 1, freeBlocks);
+}
+
+//queues a block taken out of a directory; it goes back to the bitmap with
+//freeRetiredBlocks after an RCU grace period, once no lockless lookup can
+//still be reading it
+void retireBlock(retiredBlocks* retired, char* blockPointer) 
+{
+    //a removal empties at most one block and its index blocks
+    if (WARN_ON_ONCE(retired->count == RD_RETIRED_MAX)) 
+    {
+        return;
+    }
+    retired->blocks[retired->count++] = blockPointer;
+}
+
+//the caller has waited for the grace period with synchronize_rcu
+void freeRetiredBlocks(retiredBlocks* retired) 
+{
+    int i;
+
+    for (i = 0; i < retired->count; i++) 
+    {
+        setBitmap(retired->blocks[i]);
+    }
+    retired->count = 0;
+}
+
+//gets the block for data block number blockIndex of a file; mappable files
+//reserve a page-aligned group at every page boundary and fill it in order
+char* getDataBlock(inode* node, int blockIndex) 
+{
+    char* previousBlock;
+
+    if (!(node->flags & INODE_FLAG_MAPPABLE)) 
+    {
+        return getFreeBlock();
+    }
+
+    if (blockIndex % RD_BLOCKS_PER_PAGE == 0) 
+    {
+        return getFreeBlockGroup();
+    }
+
+    previousBlock = NULL;
+    mapFilepositionToMemAddr(node, (blockIndex - 1) * RD_BLOCK_SIZE, &previousBlock);
+    return previousBlock + RD_BLOCK_SIZE;
+}
+
+char* allocateBlock(inode* node) 
+{
+    int locationCount;
+    int blockIndex;
+    int iter, iter1,iter2;
+    singleIndirectLevel* level;
+    doubleIndirectLevel* doubleLevel;
+    char* blockAddress;
+
+    level = NULL;
+    doubleLevel = NULL;
+    locationCount = node->locationCount;
+    blockIndex = node->size / RD_BLOCK_SIZE;
+
+    //lockless directory lookups follow these pointers, so every block is
+    //filled in before the pointer or count that reaches it is stored
+    if (locationCount < 8) 
+    {
+        node->location[locationCount] = getDataBlock(node, blockIndex);
+        smp_wmb();
+        node->locationCount++;
+        return node->location[locationCount];
+    }
+
+    else if (locationCount == 8) {
+        node->location[8] = getFreeBlock(); // stores RD_BLOCK_POINTERS ptrs
+        level = (singleIndirectLevel*) node->location[8];
+        level->pointers[0] = getDataBlock(node, blockIndex);
+        smp_wmb();
+        node->locationCount++;
+        return level->pointers[0];
+    }
+    
+    else if (locationCount == 9) 
+    {
+        level = (singleIndirectLevel*) node->location[8];
+        
+        for (iter = 0; iter < RD_BLOCK_POINTERS; iter++) 
+        {
+            if (level->pointers[iter] == NULL) 
+            {
+                blockAddress = getDataBlock(node, blockIndex);
+                smp_wmb();
+                level->pointers[iter] = blockAddress;
+                return level->pointers[iter];
+            }
+        }
+
+        node->location[9] = getFreeBlock();
+        doubleLevel = (doubleIndirectLevel*) node->location[9];
+        doubleLevel->pointers[0] = (singleIndirectLevel*) getFreeBlock();
+        doubleLevel->pointers[0]->pointers[0] = getDataBlock(node, blockIndex);
+        smp_wmb();
+        node->locationCount++;
+        return doubleLevel->pointers[0]->pointers[0];
+    }
+
+    else if (locationCount == 10) 
+    {
+        doubleLevel = (doubleIndirectLevel*) node->location[9];
+        for (iter1 = 0; iter1 < RD_BLOCK_POINTERS; iter1++) 
+        {
+            if (doubleLevel->pointers[iter1] == NULL) 
+            {
+                level = (singleIndirectLevel*) getFreeBlock();
+                if (level == NULL) 
+                {
+                    return NULL;
+                }
+                level->pointers[0] = getDataBlock(node, blockIndex);
+                smp_wmb();
+                doubleLevel->pointers[iter1] = level;
+                return level->pointers[0];
+            }
+            level = doubleLevel->pointers[iter1];
+            for (iter2 = 0; iter2 < RD_BLOCK_POINTERS; iter2++) 
+            {
+                if (level->pointers[iter2] == NULL) 
+                {
+                    blockAddress = getDataBlock(node, blockIndex);
+                    smp_wmb();
+                    level->pointers[iter2] = blockAddress;
+                    return level->pointers[iter2];
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+//releases every block of the inode, including the indirect pointer blocks
+void freeInodeBlocks(inode* node) 
+{
+    int directCount, dataBlocks;
+    int i, j;
+    singleIndirectLevel* singleIndirectBlock;
+    doubleIndirectLevel* doubleIndirectBlock;
+    char* groupAddress;
+    int mappable;
+
+    mappable = node->flags & INODE_FLAG_MAPPABLE;
+    directCount = getMin(node->locationCount, 8);
+
+    //mapped files free their data by whole groups below
+    if (mappable && node->locationCount > 0) 
+    {
+        dataBlocks = (node->size + RD_BLOCK_SIZE - 1) / RD_BLOCK_SIZE;
+        if (dataBlocks == 0) 
+        {
+            dataBlocks = 1;
+        }
+
+        for (i = 0; i < dataBlocks; i += RD_BLOCKS_PER_PAGE) 
+        {
+            groupAddress = NULL;
+            mapFilepositionToMemAddr(node, i * RD_BLOCK_SIZE, &groupAddress);
+            freeBlockGroup(groupAddress);
+        }
+    }
+
+    for (i = 0; i < directCount; i++) 
+    {
+        if (node->location[i] == NULL) 
+        {
+            break;
+        }
+
+        if (!mappable) 
+        {
+            setBitmap(node->location[i]);
+        }
+    }
+
+    if (node->locationCount > 8) 
+    {
+        singleIndirectBlock = (singleIndirectLevel*) node->location[8];
+
+        for (i = 0; i < RD_BLOCK_POINTERS && singleIndirectBlock->pointers[i]; i++) 
+        {
+            if (!mappable) 
+            {
+                setBitmap(singleIndirectBlock->pointers[i]);
+            }
+        }
+        setBitmap(node->location[8]);
+    }
+
+    if (node->locationCount == 10) 
+    {
+        doubleIndirectBlock = (doubleIndirectLevel*) node->location[9];
+
+        for (i = 0; i < RD_BLOCK_POINTERS && doubleIndirectBlock->pointers[i]; i++) 
+        {
+            singleIndirectBlock = doubleIndirectBlock->pointers[i];
+
+            for (j = 0; j < RD_BLOCK_POINTERS && singleIndirectBlock->pointers[j]; j++) 
+            {
+                if (!mappable) 
+                {
+                    setBitmap(singleIndirectBlock->pointers[j]);
+                }
+            }
+            setBitmap((char*) singleIndirectBlock);
+        }
+        setBitmap(node->location[9]);
+    }
+
+    for (i = 0; i < INODE_BLOCK_POINTERS; i++) 
+    {
+        node->location[i] = NULL;
+    }
+    node->locationCount = 0;
+}
+
+//moves the contents of a regular file into page-aligned block groups so that
+//it can be mapped; the copy is built beside the file and swapped in only
+//once complete, so on failure the file keeps its blocks untouched
+int relocateToBlockGroups(inode* node) 
+{
+    inode relocated;
+    inode previous;
+    char* filePositionAddress;
+    int size, position, bytesToCopy;
+
+    size = node->size;
+    relocated = *node;
+    memset(relocated.location, 0, sizeof(relocated.location));
+    relocated.flags |= INODE_FLAG_MAPPABLE;
+    relocated.size = 0;
+    relocated.locationCount = 0;
+
+    relocated.location[0] = getDataBlock(&relocated, 0);
+    if (!relocated.location[0]) 
+    {
+        return -1;
+    }
+    relocated.locationCount = 1;
+
+    for (position = 0; position < size; position += bytesToCopy) 
+    {
+        bytesToCopy = getMin(mapFilepositionToMemAddr(node, position, &filePositionAddress), size - position);
+        if (writeInodeRange(&relocated, position, filePositionAddress, bytesToCopy) != bytesToCopy) 
+        {
+            freeInodeBlocks(&relocated);
+            return -1;
+        }
+    }
+
+    //only the swap of the block pointers is seen by lockless readers
+    previous = *node;
+    beginInodeChange(node);
+    memcpy(node->location, relocated.location, sizeof(node->location));
+    node->locationCount = relocated.locationCount;
+    node->flags = relocated.flags;
+    endInodeChange(node);
+
+    freeInodeBlocks(&previous);
+    return 0;
+}
+
+//searches one directory block; lockless lookups may see it mid-update, so
+//inode numbers are range checked and names never read past the entry
+int existsInBlock(char* blockAddress, char* fileName, char* type) 
+{
+    dirEntry* dirTraverser;
+    char* dirEntryFileName;
+    int dirEntryInodeNumber;
+    char* dirEntryType;
+    int i;
+    char* dirEntryIter;
+    int entryCount;
+
+    dirEntryIter = blockAddress;
+    entryCount = RD_BLOCK_SIZE / DIR_ENTRY_STRUCTURE_SIZE;
+    for (i = 0; i < entryCount; i++) {
+        dirTraverser = (dirEntry*) dirEntryIter;
+        dirEntryFileName = dirTraverser->fileName;
+        dirEntryInodeNumber = dirTraverser->inodeNumber;
+    
+        if (dirEntryInodeNumber < 0 || dirEntryInodeNumber >= INODE_COUNT) 
+        {
+            return -1;
+        }
+        if (strncmp(dirEntryFileName, "/", DIR_ENTRY_FILENAME_SIZE) != 0 && dirEntryInodeNumber == 0) 
+        {
+            return -1;
+        }
+
+        if (strncmp(dirEntryFileName, fileName, DIR_ENTRY_FILENAME_SIZE) == 0) 
+        {
+            dirEntryType = inodeArray[dirEntryInodeNumber].type;
+            if ((strcmp("ign", type) == 0) || (strncmp(dirEntryType, type, INODE_TYPE_SIZE) == 0))
+            {        
+                return dirEntryInodeNumber;
+            }
+        }        
+        
+        dirEntryIter += DIR_ENTRY_STRUCTURE_SIZE;
+    }
+
+    return -1;
+}
+
+int getLastEntry(char* blockAddress, char** lastEntry) 
+{
+    dirEntry* dirTraverser;
+    char* dirEntryIterPrev;
+    char* dirEntryIter;
+    int i;
+    int entryCount;
+    char* dirEntryFileName;
+    int dirEntryInodeNumber;
+
+    entryCount = RD_BLOCK_SIZE / DIR_ENTRY_STRUCTURE_SIZE;
+    dirEntryIter = dirEntryIterPrev = blockAddress;
+
+    for (i = 0; i < entryCount; i++) 
+    {
+        dirTraverser = (dirEntry*) dirEntryIter;
+        dirEntryFileName = dirTraverser->fileName;
+        dirEntryInodeNumber = dirTraverser->inodeNumber;
+
+        if (strcmp(dirEntryFileName, "/") != 0 && dirEntryInodeNumber == 0) 
+        {
+            if (dirEntryIter == dirEntryIterPrev) 
+            {
+                *lastEntry = NULL;
+                return -1;
+            }
+            *lastEntry = dirEntryIterPrev;
+            return 1;
+        }
+        
+        dirEntryIterPrev = dirEntryIter;
+        dirEntryIter += DIR_ENTRY_STRUCTURE_SIZE;
+    }
+        
+    *lastEntry = dirEntryIterPrev;
+
+    return 1;
+}
+
+
+char* scanBlockForFreeSlot(char* blockAddress) {
+    dirEntry* dirTraverser;
+    char* dirEntryIter = blockAddress;
+    int i;
+    char* dirEntryFileName;
+    int dirEntryInodeNumber;
+    int entryCount;
+    entryCount = RD_BLOCK_SIZE / DIR_ENTRY_STRUCTURE_SIZE;
+    for (i = 0; i < entryCount; i++) 
+    {
+        dirTraverser = (dirEntry*) dirEntryIter;
+        dirEntryFileName = dirTraverser->fileName;
+        dirEntryInodeNumber = dirTraverser->inodeNumber;
+        if (strcmp(dirEntryFileName, "/") != 0 && dirEntryInodeNumber == 0) {
+            return dirEntryIter;
+        }
+        dirEntryIter += DIR_ENTRY_STRUCTURE_SIZE;
+    }
+    return NULL;
+}
+
+//returns the last entry of the directory, retiring the empty blocks behind it
+char* findLastEntry(int inodeNumber, retiredBlocks* retired) {
+    int locationCount;
+    char* blockAddress;
+    singleIndirectLevel* indirectBlock;
+    doubleIndirectLevel* doubleIndirectBlock;
+    char* dirEntryIter;
+    int i, j, count;
+    char* lastEntry;
+    int ret;
+
+    locationCount = inodeArray[inodeNumber].locationCount;
+    
+   
+    if (locationCount == 10) 
+    {
+        doubleIndirectBlock = (doubleIndirectLevel*) inodeArray[inodeNumber].location[9];
+        for (i = RD_BLOCK_POINTERS - 1; i >= 0; i--) 
+        {
+            indirectBlock = doubleIndirectBlock->pointers[i];
+
+            if (!indirectBlock) 
+            {
+                continue;
+            }
+
+            for (j = RD_BLOCK_POINTERS - 1; j >= 0; j--) 
+            {
+                dirEntryIter = indirectBlock->pointers[j];
+
+                if (!dirEntryIter) {
+                    continue;
+                }
+                
+                ret = getLastEntry(dirEntryIter, &lastEntry);
+                if (ret == 1) 
+                {
+                    return lastEntry;
+                }
+
+                else if (ret == -1) 
+                {
+                    retireBlock(retired, dirEntryIter);
+                    indirectBlock->pointers[j] = NULL;
+                    if (j == 0) 
+                    {
+                        retireBlock(retired, (char*)indirectBlock);
+                        doubleIndirectBlock->pointers[i] = NULL;
+                    }
+                }
+            }
+        }
+        retireBlock(retired, inodeArray[inodeNumber].location[9]);
+        inodeArray[inodeNumber].location[9] = NULL;
+        inodeArray[inodeNumber].locationCount--;
+    }
+
+    locationCount = inodeArray[inodeNumber].locationCount;
+    if (locationCount > 8) 
+    {
+        // Get the base address of the block holding indirect pointers
+        indirectBlock = (singleIndirectLevel*) inodeArray[inodeNumber].location[8];
+
+        // Iterate all block pointers
+        for (i = RD_BLOCK_POINTERS - 1; i >= 0; i--) {
+            // Get block pointed to by indirect pointer
+            dirEntryIter = indirectBlock->pointers[i];
+
+            // If this single indirect block has no more pointers to blocks...
+            if (!dirEntryIter) 
+            {
+                continue;
+            }
+
+            // Check if this file exists in the block
+            ret = getLastEntry(dirEntryIter, &lastEntry);
+            // If the files inode number is not -1, then return this inode
+            if (ret == 1) 
+            {
+                    return lastEntry;
+            }
+            else if (ret == -1) 
+            {
+                retireBlock(retired, dirEntryIter);
+                indirectBlock->pointers[i] = NULL;
+                if (i == 0) 
+                {
+                    retireBlock(retired, inodeArray[inodeNumber].location[8]);
+                    inodeArray[inodeNumber].location[8] = NULL;
+                    inodeArray[inodeNumber].locationCount--;
+                }
+            }
+        }
+    }
+
+    locationCount = inodeArray[inodeNumber].locationCount;
+    count = locationCount - 1;
+    while (count >= 0) 
+    {
+        blockAddress = inodeArray[inodeNumber].location[count];
+                     
+        ret = getLastEntry(blockAddress, &lastEntry);
+        if (ret == 1) 
+        {
+            return lastEntry;
+        }
+        else if (ret == -1) 
+        {
+            retireBlock(retired, blockAddress);
+            inodeArray[inodeNumber].locationCount--;
+        }
+            
+        count--;
+    }                
+    
+    return NULL;
+}
+
+int deleteFromBlock(char* blockAddress, char* fileName, char* type, int parentInodeNumber, retiredBlocks* retired) {
+    dirEntry* dirTraverser;
+    char* dirEntryIter = blockAddress;
+    int i;
+    int entryCount;
+    char* dirEntryFileName;
+    int dirEntryInodeNumber;
+    char* dirEntryType;
+    char* lastEntry;
+
+    entryCount = RD_BLOCK_SIZE / DIR_ENTRY_STRUCTURE_SIZE;
+
+    for (i = 0; i < entryCount; i++) 
+    {
+        dirTraverser = (dirEntry*) dirEntryIter;
+        dirEntryFileName = dirTraverser->fileName;
+        dirEntryInodeNumber = dirTraverser->inodeNumber;
+        dirEntryType = inodeArray[dirEntryInodeNumber].type;
+
+        if (strcmp(dirEntryFileName, "/") != 0 && dirEntryInodeNumber == 0) 
+        {
+            return -1;
+        }
+
+        if (strcmp(dirEntryFileName, fileName) == 0) 
+        {
+            if ((strcmp("ign", type) == 0) || (strcmp(dirEntryType, type) == 0)) 
+            {
+                lastEntry = findLastEntry(parentInodeNumber, retired);
+
+                memcpy(dirEntryIter, lastEntry, DIR_ENTRY_STRUCTURE_SIZE);
+                memset(lastEntry, 0, DIR_ENTRY_STRUCTURE_SIZE);
+
+                return dirEntryInodeNumber;
+            }
+        }
+        dirEntryIter += DIR_ENTRY_STRUCTURE_SIZE;
+    }
+    return -1;
+}
+
+//searches directory inodeNumber for fileName of type; safe without the
+//directory lock inside rcu_read_lock, where a concurrent change can make it
+//miss or misreport an entry and the caller retries on the sequence count;
+//blocksScanned is increased by the number of blocks searched
+static int searchDir(int inodeNumber, char* fileName, char* type, int* blocksScanned) 
+{
+    int locationCount;
+    int directCount;
+    int dirEntryInodeNumber;
+    char* blockAddress;
+    singleIndirectLevel* indirectBlock;
+    doubleIndirectLevel* doubleIndirectBlock;
+    char* dirEntryIter;
+    int i, j, pointerCount, count;
+    
+    directCount = count = 0;
+    pointerCount = RD_BLOCK_POINTERS;
+    locationCount = ACCESS_ONCE(inodeArray[inodeNumber].locationCount);
+    smp_rmb();
+    if (locationCount > 8) 
+    {
+        directCount = 8;
+    }
+    else 
+    {
+        directCount = locationCount;
+    }
+ 
+    while (count < directCount) 
+    {
+        blockAddress = ACCESS_ONCE(inodeArray[inodeNumber].location[count]);
+        if (!blockAddress) 
+        {
+            break;
+        }
+        
+        (*blocksScanned)++;
+        dirEntryInodeNumber = existsInBlock(blockAddress, fileName, type);
+
+        if (dirEntryInodeNumber != -1) 
+        {
+            return dirEntryInodeNumber;
+        }
+
+        count++;                
+    }
+
+    if (locationCount > 8) 
+    {
+        indirectBlock = (singleIndirectLevel*) ACCESS_ONCE(inodeArray[inodeNumber].location[8]);
+
+        for (i = 0; indirectBlock && i < pointerCount; i++) 
+        {
+            dirEntryIter = ACCESS_ONCE(indirectBlock->pointers[i]);
+   
+            if (!dirEntryIter) {
+                break;
+            }
+
+            (*blocksScanned)++;
+            dirEntryInodeNumber = existsInBlock(dirEntryIter, fileName, type);
+            if (dirEntryInodeNumber != -1)
+            {
+                return dirEntryInodeNumber;
+            }
+        }
+    }
+
+    if (locationCount == 10) 
+    {
+        doubleIndirectBlock = (doubleIndirectLevel*) ACCESS_ONCE(inodeArray[inodeNumber].location[9]);
+        
+        for (i = 0; doubleIndirectBlock && i < pointerCount; i++) 
+        {
+            indirectBlock = ACCESS_ONCE(doubleIndirectBlock->pointers[i]);
+    
+            if (!indirectBlock) 
+            {
+                break;
+            }
+
+            for (j = 0; j < pointerCount; j++) 
+            {
+                dirEntryIter = ACCESS_ONCE(indirectBlock->pointers[j]);
+
+                if (!dirEntryIter) 
+                {
+                    break;
+                }
+
+                (*blocksScanned)++;
+                dirEntryInodeNumber = existsInBlock(dirEntryIter, fileName, type);
+
+                if (dirEntryInodeNumber != -1) 
+                {
+                    return dirEntryInodeNumber;
+                }
+            }
+        }    
+    }
+    return -1;
+}
+
+int isDirEntry(int inodeNumber, char* fileName, char* type) 
+{
+    int blocksScanned;
+
+    blocksScanned = 0;
+    return searchDir(inodeNumber, fileName, type, &blocksScanned);
+}
+
+//removes the entry from directory inodeNumber; the caller is inside a write
+//section of its sequence count and frees the retired blocks afterwards
+int unlinkHelper(int inodeNumber, char* fileName, char* type, retiredBlocks* retired) 
+{
+    int locationCount;
+    int directCount;
+    int dirEntryInodeNumber;
+    char* blockAddress;
+    singleIndirectLevel* indirectBlock;
+    doubleIndirectLevel* doubleIndirectBlock;
+    char* dirEntryIter;
+    int i, j, pointerCount, count;
+
+    directCount = count = 0;
+    pointerCount = RD_BLOCK_POINTERS;
+    locationCount = inodeArray[inodeNumber].locationCount;
+
+    if (locationCount > 8)
+    {
+        directCount = 8;
+    }
+    else 
+    {
+        directCount = locationCount;
+    }
+
+    while (count < directCount) 
+    {
+        blockAddress = inodeArray[inodeNumber].location[count];
+
+        dirEntryInodeNumber = deleteFromBlock(blockAddress, fileName, type, inodeNumber, retired);
+
+        if (dirEntryInodeNumber != -1) {
+            return dirEntryInodeNumber;
+        }
+
+        count++;
+    }
+
+    if (locationCount > 8) 
+    {
+        indirectBlock = (singleIndirectLevel*) inodeArray[inodeNumber].location[8];
+
+        for (i = 0; i < pointerCount; i++) 
+        {
+            dirEntryIter = indirectBlock->pointers[i];
+
+            if (!dirEntryIter)
+            {
+                break;
+            }
+
+            dirEntryInodeNumber = deleteFromBlock(dirEntryIter, fileName, type, inodeNumber, retired);
+            if (dirEntryInodeNumber != -1) 
+            {
+                return dirEntryInodeNumber;
+            }
+        }
+    }
+
+    if (locationCount == 10) 
+    {
+        doubleIndirectBlock = (doubleIndirectLevel*) inodeArray[inodeNumber].location[9];
+
+        for (i = 0; i < pointerCount; i++) 
+        {
+            indirectBlock = doubleIndirectBlock->pointers[i];
+
+            if (!indirectBlock) 
+            {
+                break;
+            }
+
+            for (j = 0; j < pointerCount; j++) 
+            {
+                dirEntryIter = indirectBlock->pointers[j];
+
+                if (!dirEntryIter) 
+                {
+                    break;
+                }
+                dirEntryInodeNumber = deleteFromBlock(dirEntryIter, fileName, type, inodeNumber, retired);
+
+                if (dirEntryInodeNumber != -1) 
+                {
+                    return dirEntryInodeNumber;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+//copies the next component of pathname into name, truncated to a directory
+//entry name, and moves past it; returns its full length, 0 at the end
+static int nextComponent(char** pathname, char* name) 
+{
+    int length;
+
+    if (**pathname == '/') 
+    {
+        (*pathname)++;
+    }
+    length = strcspn(*pathname, "/");
+
+    memcpy(name, *pathname, getMin(length, DIR_ENTRY_FILENAME_SIZE));
+    name[getMin(length, DIR_ENTRY_FILENAME_SIZE)] = '\0';
+    *pathname += length;
+    return length;
+}
+
+//searches directory inodeNumber, whose generation was dirGeneration, for
+//fileName without a lock; returns -2 if the directory changed meanwhile
+//and the lookup must start over, otherwise the entry or -1
+static int lookupInDir(int inodeNumber, unsigned int dirGeneration, char* fileName, char* type, unsigned int* generation, int* blocksScanned) 
+{
+    unsigned int seq;
+    int fileInodeNum;
+
+    seq = read_seqcount_begin(&inodeSeqs[inodeNumber]);
+    fileInodeNum = searchDir(inodeNumber, fileName, type, blocksScanned);
+    if (fileInodeNum != -1) 
+    {
+        *generation = ACCESS_ONCE(inodeGenerations[fileInodeNum]);
+    }
+    if (read_seqcount_retry(&inodeSeqs[inodeNumber], seq) || ACCESS_ONCE(inodeGenerations[inodeNumber]) != dirGeneration) 
+    {
+        return -2;
+    }
+    return fileInodeNum;
+}
+
+//resolves the directory pathname without taking any lock: every level is
+//searched under rcu_read_lock and checked against its sequence count; the
+//returned generation lets a caller that locks the directory afterwards
+//detect that it was unlinked in between; depth and blocksScanned count the
+//components walked and the directory blocks searched
+static int walkDir(char* pathname, unsigned int* generation, int* depth, int* blocksScanned) 
+{
+    char name[DIR_ENTRY_FILENAME_SIZE + 1];
+    char* component;
+    unsigned int dirGeneration;
+    int inodeNumber;
+    int length;
+
+    rcu_read_lock();
+    component = pathname;
+    inodeNumber = 0;
+    dirGeneration = ACCESS_ONCE(inodeGenerations[0]);
+
+    while ((length = nextComponent(&component, name)) > 0) 
+    {
+        if (length > DIR_ENTRY_FILENAME_SIZE) 
+        {
+            inodeNumber = -1;
+            break;
+        }
+
+        (*depth)++;
+        inodeNumber = lookupInDir(inodeNumber, dirGeneration, name, "dir", &dirGeneration, blocksScanned);
+        if (inodeNumber == -2) 
+        {
+            //an entry on the way moved, start again from the root
+            component = pathname;
+            inodeNumber = 0;
+            dirGeneration = ACCESS_ONCE(inodeGenerations[0]);
+            continue;
+        }
+        if (inodeNumber == -1) 
+        {
+            break;
+        }
+    }
+    rcu_read_unlock();
+
+    *generation = dirGeneration;
+    return inodeNumber;
+}
+
+int lookupDir(char* pathname, unsigned int* generation) 
+{
+    int inodeNumber;
+    int depth, blocksScanned;
+
+    depth = blocksScanned = 0;
+    inodeNumber = walkDir(pathname, generation, &depth, &blocksScanned);
+    trace_ramdisk_lookup(inodeNumber, depth, blocksScanned);
+    return inodeNumber;
+}
+
+//resolves pathname to its inode of type without taking any lock, see
+//lookupDir; generation receives the generation of the inode found
+int lookupPath(char* pathname, char* type, unsigned int* generation) 
+{
+    char* parents;
+    char* fileName;
+    unsigned int dirGeneration;
+    int parentInodeNum;
+    int fileInodeNum;
+    int depth, blocksScanned;
+
+    if (parse(pathname, &parents, &fileName) == -1) 
+    {
+        return -1;
+    }
+
+    depth = blocksScanned = 0;
+    do 
+    {
+        parentInodeNum = walkDir(parents, &dirGeneration, &depth, &blocksScanned);
+        if (parentInodeNum == -1) 
+        {
+            fileInodeNum = -1;
+            break;
+        }
+
+        depth++;
+        rcu_read_lock();
+        fileInodeNum = lookupInDir(parentInodeNum, dirGeneration, fileName, type, generation, &blocksScanned);
+        rcu_read_unlock();
+    } while (fileInodeNum == -2);
+
+    freePath(parents);
+    trace_ramdisk_lookup(fileInodeNum, depth, blocksScanned);
+    return fileInodeNum;
+}
+
+//bumped each time inodeNumber is unlinked, so a frontend that caches inode
+//numbers can tell a reused one apart
+unsigned int inodeGeneration(int inodeNumber) 
+{
+    return ACCESS_ONCE(inodeGenerations[inodeNumber]);
+}
+
+//resolves the directory pathname and returns it locked, for writing if
+//exclusive is set; only the directory itself is locked, the walk to it is
+//lockless and retried if the directory was unlinked before it was locked
+int getDirInodeNumber(char* pathname, int exclusive) {
+    unsigned int generation;
+    int inodeNumber;
+
+    for (;;) 
+    {
+        inodeNumber = lookupDir(pathname, &generation);
+        if (inodeNumber == -1) 
+        {
+            return -1;
+        }
+
+        lockInode(inodeNumber, exclusive);
+        if (inodeGenerations[inodeNumber] == generation) 
+        {
+            return inodeNumber;
+        }
+        unlockInode(inodeNumber, exclusive);
+    }
+}       
+
+//resolves pathname to its inode of type and returns it locked, for writing
+//if exclusive is set, or -1; no directory is locked on the way
+int lockPathInode(char* pathname, char* type, int exclusive) 
+{
+    unsigned int generation;
+    int fileInodeNum;
+
+    for (;;) 
+    {
+        fileInodeNum = lookupPath(pathname, type, &generation);
+        if (fileInodeNum == -1) 
+        {
+            return -1;
+        }
+
+        lockInode(fileInodeNum, exclusive);
+        if (inodeGenerations[fileInodeNum] == generation) 
+        {
+            return fileInodeNum;
+        }
+        unlockInode(fileInodeNum, exclusive);
+    }
+}
+
+
+//returns the parent directory of pathname write locked if it has no entry
+//of type yet, -1 otherwise
+int validateFile(char* pathname, char* type) {
+    char* fileName;
+        char* parents; 
+    int parentInodeNum;
+    int isDir;
+
+    fileName = parents = NULL;
+    if (parse(pathname, &parents, &fileName) == -1) 
+    {
+        return -1;
+    }
+
+    parentInodeNum = getDirInodeNumber(parents, TRUE);
+
+    if (parentInodeNum == -1) 
+    {
+        freePath(parents);
+        rdStatInc(RD_STAT_ERR_NOENT);
+        return -1;
+    }
+
+    isDir = isDirEntry(parentInodeNum, fileName, type);
+    freePath(parents);
+
+    if (isDir == -1) 
+    {
+        return parentInodeNum;
+    }
+    else
+    {
+        unlockInode(parentInodeNum, TRUE);
+        rdStatInc(RD_STAT_ERR_EXIST);
+        return -1;
+    }
+}
+
+//resolves pathname to its inode of type; parentInodeNum receives the parent
+//directory, or -1 if that does not exist, and a found parent is left locked
+//as getDirInodeNumber does for the caller to unlock
+int getInodeNumber(char* pathname, char* type, int* parentInodeNum, int exclusive) 
+{
+    char* parents;
+    char* fileName;
+    int fileInodeNum;
+
+    fileInodeNum = -1;
+    *parentInodeNum = -1;
+    if (parse(pathname, &parents, &fileName) == -1) 
+    {
+        return -1;
+    }
+
+    *parentInodeNum = getDirInodeNumber(parents, exclusive);
+    if (*parentInodeNum != -1) 
+    {
+        fileInodeNum = isDirEntry(*parentInodeNum, fileName, type);
+    }
+
+    freePath(parents);
+    return fileInodeNum;
+}
+
+//spreads the bits of value over the whole word
+static unsigned int mixHash(unsigned int value) 
+{
+    value ^= value >> 16;
+    value *= 0x85ebca6b;
+    value ^= value >> 13;
+    value *= 0xc2b2ae35;
+    value ^= value >> 16;
+    return value;
+}
+
+//FNV-1a of the first length bytes of path, started from salt
+static unsigned int hashPath(char* path, int length, unsigned int salt) 
+{
+    unsigned int hash;
+    int i;
+
+    hash = 2166136261u ^ salt;
+    for (i = 0; i < length; i++) 
+    {
+        hash ^= (unsigned char) path[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static unsigned int indexBucket(pathIndex* index, unsigned int hash) 
+{
+    return mixHash(hash) & (index->bucketCount - 1);
+}
+
+static unsigned int indexSlot(pathIndex* index, unsigned int hash, unsigned int seed) 
+{
+    return mixHash(hash ^ seed) & (index->slotCount - 1);
+}
+
+//lists every path below the root into index->entries, parents first, and
+//spells them out in index->paths; nothing may change the tree meanwhile
+static int collectPaths(pathIndex* index) 
+{
+    pathEntry* entry;
+    dirEntry* child;
+    inode* dir;
+    char* entryAddress;
+    char* path;
+    int i, position, length, total;
+
+    index->entries = (pathEntry*) vmalloc(sizeof(pathEntry) * INODE_COUNT);
+    if (!index->entries) 
+    {
+        return -1;
+    }
+
+    //the list doubles as the queue of directories to visit, -1 is the root
+    total = 0;
+    index->entryCount = 0;
+    for (i = -1; i < index->entryCount; i++) 
+    {
+        dir = &inodeArray[i == -1 ? 0 : index->entries[i].inodeNumber];
+        if (strcmp(dir->type, "dir") != 0) 
+        {
+            continue;
+        }
+
+        for (position = 0; position < dir->size; position += DIR_ENTRY_STRUCTURE_SIZE) 
+        {
+            mapFilepositionToMemAddr(dir, position, &entryAddress);
+            child = (dirEntry*) entryAddress;
+
+            length = (i == -1 ? 0 : index->entries[i].length) + 1 + strnlen(child->fileName, DIR_ENTRY_FILENAME_SIZE);
+            //longer paths cannot be passed in anyway
+            if (length >= RD_PATH_MAX || index->entryCount == INODE_COUNT) 
+            {
+                continue;
+            }
+
+            entry = &index->entries[index->entryCount++];
+            entry->inodeNumber = child->inodeNumber;
+            entry->parent = i;
+            entry->name = child->fileName;
+            entry->offset = total;
+            entry->length = length;
+            total += length + 1;
+        }
+    }
+
+    index->paths = (char*) vmalloc(total + 1);
+    if (!index->paths) 
+    {
+        return -1;
+    }
+
+    for (i = 0; i < index->entryCount; i++) 
+    {
+        entry = &index->entries[i];
+        path = index->paths + entry->offset;
+        length = 0;
+        if (entry->parent != -1) 
+        {
+            length = index->entries[entry->parent].length;
+            memcpy(path, index->paths + index->entries[entry->parent].offset, length);
+        }
+        path[length] = '/';
+        memcpy(path + length + 1, entry->name, entry->length - length - 1);
+        path[entry->length] = '\0';
+    }
+    return 0;
+}
+
+//looks for a seed that puts every path of bucket into a free slot of its
+//own; returns -1 if there is none
+static int placeBucket(pathIndex* index, unsigned int bucket, int head) 
+{
+    unsigned int seed, slot;
+    int entry, placed;
+
+    for (seed = 1; seed <= RD_INDEX_SEEDS; seed++) 
+    {
+        for (entry = head; entry != -1; entry = index->entries[entry].next) 
+        {
+            slot = indexSlot(index, index->entries[entry].hash, seed);
+            if (index->slots[slot] != -1) 
+            {
+                break;
+            }
+            index->slots[slot] = entry;
+        }
+        if (entry == -1) 
+        {
+            index->seeds[bucket] = seed;
+            return 0;
+        }
+
+        //take back what this seed placed
+        for (placed = head; placed != entry; placed = index->entries[placed].next) 
+        {
+            index->slots[indexSlot(index, index->entries[placed].hash, seed)] = -1;
+        }
+    }
+    return -1;
+}
+
+//hashes every path with salt and places the buckets, fullest first while
+//the table is still empty enough to find seeds easily
+static int placePaths(pathIndex* index, unsigned int salt, int* heads, int* sizes) 
+{
+    pathEntry* entry;
+    unsigned int bucket;
+    int i, size, largest;
+
+    index->salt = salt;
+    for (i = 0; i < index->bucketCount; i++) 
+    {
+        heads[i] = -1;
+        sizes[i] = 0;
+        index->seeds[i] = 0;
+    }
+    for (i = 0; i < index->slotCount; i++) 
+    {
+        index->slots[i] = -1;
+    }
+
+    largest = 0;
+    for (i = 0; i < index->entryCount; i++) 
+    {
+        entry = &index->entries[i];
+        entry->hash = hashPath(index->paths + entry->offset, entry->length, salt);
+        bucket = indexBucket(index, entry->hash);
+        entry->next = heads[bucket];
+        heads[bucket] = i;
+        sizes[bucket]++;
+        largest = sizes[bucket] > largest ? sizes[bucket] : largest;
+    }
+
+    for (size = largest; size > 0; size--) 
+    {
+        for (bucket = 0; bucket < index->bucketCount; bucket++) 
+        {
+            if (sizes[bucket] == size && placeBucket(index, bucket, heads[bucket]) == -1) 
+            {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+//builds the path index of the whole tree; the caller keeps every change
+//out, see ram_freeze
+pathIndex* buildPathIndex(void) 
+{
+    pathIndex* index;
+    int* heads;
+    int* sizes;
+    unsigned int salt;
+    int ret;
+
+    index = (pathIndex*) vmalloc(sizeof(pathIndex));
+    if (!index) 
+    {
+        return NULL;
+    }
+    memset(index, 0, sizeof(pathIndex));
+
+    if (collectPaths(index) == -1) 
+    {
+        freePathIndex(index);
+        return NULL;
+    }
+
+    //about four paths per bucket, and at most half of the slots in use
+    index->bucketCount = 1;
+    while (index->bucketCount * 4 < index->entryCount) 
+    {
+        index->bucketCount <<= 1;
+    }
+    index->slotCount = 2;
+    while (index->slotCount < 2 * index->entryCount) 
+    {
+        index->slotCount <<= 1;
+    }
+
+    index->seeds = (unsigned int*) vmalloc(sizeof(unsigned int) * index->bucketCount);
+    index->slots = (int*) vmalloc(sizeof(int) * index->slotCount);
+    heads = (int*) vmalloc(sizeof(int) * index->bucketCount);
+    sizes = (int*) vmalloc(sizeof(int) * index->bucketCount);
+
+    ret = -1;
+    if (index->seeds && index->slots && heads && sizes) 
+    {
+        //a new salt helps when two paths hash alike
+        for (salt = 0; salt < RD_INDEX_SALTS && ret == -1; salt++) 
+        {
+            ret = placePaths(index, salt, heads, sizes);
+        }
+    }
+
+    if (heads) 
+    {
+        vfree(heads);
+    }
+    if (sizes) 
+    {
+        vfree(sizes);
+    }
+    if (ret == -1) 
+    {
+        printk("fail to index the paths\n");
+        freePathIndex(index);
+        return NULL;
+    }
+    return index;
+}
+
+void freePathIndex(pathIndex* index) 
+{
+    if (index->seeds) 
+    {
+        vfree(index->seeds);
+    }
+    if (index->slots) 
+    {
+        vfree(index->slots);
+    }
+    if (index->entries) 
+    {
+        vfree(index->entries);
+    }
+    if (index->paths) 
+    {
+        vfree(index->paths);
+    }
+    vfree(index);
+}
+
+//resolves pathname of type with the index of a frozen filesystem; paths
+//that are not spelled the way the index stores them are not found
+int lookupFrozenPath(pathIndex* index, char* pathname, char* type) 
+{
+    pathEntry* entry;
+    unsigned int hash;
+    int length, slot;
+
+    if (index->entryCount == 0) 
+    {
+        return -1;
+    }
+
+    length = strlen(pathname);
+    hash = hashPath(pathname, length, index->salt);
+    slot = index->slots[indexSlot(index, hash, index->seeds[indexBucket(index, hash)])];
+    if (slot == -1) 
+    {
+        return -1;
+    }
+
+    entry = &index->entries[slot];
+    if (entry->length != length || memcmp(index->paths + entry->offset, pathname, length) != 0) 
+    {
+        return -1;
+    }
+    if (strcmp(type, "ign") != 0 && strcmp(inodeArray[entry->inodeNumber].type, type) != 0) 
+    {
+        return -1;
+    }
+    return entry->inodeNumber;
+}
+
+dirEntry* getFreeDirEntry(int inodeNumber) {
+    int locationCount;
+    char* freeSlot;
+    char* blockAddress;
+    singleIndirectLevel* indirectBlock;
+    doubleIndirectLevel* doubleIndirectBlock;
+    char* dirEntryIter;
+    int i, j, pointerCount;
+
+    pointerCount = RD_BLOCK_POINTERS;
+    locationCount = inodeArray[inodeNumber].locationCount;
+
+    if (locationCount <= 8) 
+    {
+            blockAddress = inodeArray[inodeNumber].location[locationCount - 1];
+
+            // See if this block has a vfree slot
+            freeSlot = scanBlockForFreeSlot(blockAddress);
+
+            if (freeSlot) {
+                return ((dirEntry*) freeSlot);
+            }
+    }
+
+    else if (locationCount == 9) 
+    {
+        indirectBlock = (singleIndirectLevel*) inodeArray[inodeNumber].location[8];
+
+        for (i = 0; i < pointerCount; i++) {
+            dirEntryIter = indirectBlock->pointers[i];
+
+            if (!dirEntryIter) 
+            {
+                break;
+            }
+            freeSlot = scanBlockForFreeSlot(dirEntryIter);
+            if (freeSlot) 
+            {
+                return ((dirEntry*) freeSlot);
+            }
+        }
+    }
+
+    else if (locationCount == 10) 
+    {
+        doubleIndirectBlock = (doubleIndirectLevel*) inodeArray[inodeNumber].location[9];
+
+        for (i = 0; i < pointerCount; i++) 
+        {
+            indirectBlock = doubleIndirectBlock->pointers[i];
+
+            if (!indirectBlock) 
+            {
+                break;
+            }
+
+            for (j = 0; j < pointerCount; j++) 
+            {
+                dirEntryIter = indirectBlock->pointers[j];
+
+                if (!dirEntryIter) 
+                {
+                    break;
+                }
+
+                freeSlot = scanBlockForFreeSlot(dirEntryIter);
+
+                if (freeSlot) 
+                {
+                    return ((dirEntry*) freeSlot);
+                }
+            }
+        }
+    }
+    
+    inode* inodePointer = &inodeArray[inodeNumber];
+    dirEntry* freeEntry = (dirEntry*) allocateBlock(inodePointer);
+    return freeEntry;
+}
+
+
+int mapFilepositionToMemAddr(inode* pointer, int filePosition, char** filePositionAddress) 
+{
+    int locationNumber;
+    int shiftWithinBlock;
+    char* filePositionTemp;
+    char* blockPtr;
+    int indirectShift;
+
+    if (filePosition < DIRECT_LIMIT) 
+    {
+        filePositionTemp = NULL;
+        locationNumber = filePosition / RD_BLOCK_SIZE;
+
+        filePositionTemp = pointer->location[locationNumber];
+
+        shiftWithinBlock = filePosition % RD_BLOCK_SIZE;
+        filePositionTemp += shiftWithinBlock;
+        *filePositionAddress = filePositionTemp;
+    }
+
+    else if (filePosition < SINGLE_INDIRECT_LIMIT) 
+    {
+        singleIndirectLevel* firstLevel = (singleIndirectLevel*) pointer->location[8];
+        filePosition -= DIRECT_SIZE;
+
+        indirectShift = filePosition / RD_BLOCK_SIZE;
+        blockPtr = firstLevel->pointers[indirectShift];
+
+        shiftWithinBlock = filePosition % RD_BLOCK_SIZE;
+        blockPtr += shiftWithinBlock;
+        *filePositionAddress = blockPtr;
+    }
+
+    else if (filePosition < DOUBLE_INDIRECT_LIMIT) {
+        blockPtr = NULL;
+        doubleIndirectLevel* doubleLevel = (doubleIndirectLevel*) pointer->location[9];
+        singleIndirectLevel* singleLevel;
+
+        filePosition -= SINGLE_INDIRECT_SIZE;
+        filePosition -= DIRECT_SIZE;
+
+        indirectShift = filePosition / SINGLE_INDIRECT_SIZE;
+
+        singleLevel = doubleLevel->pointers[indirectShift];
+
+        filePosition -= (indirectShift * SINGLE_INDIRECT_SIZE);
+
+        indirectShift = filePosition / RD_BLOCK_SIZE;
+        blockPtr = singleLevel->pointers[indirectShift];
+
+        shiftWithinBlock = filePosition % RD_BLOCK_SIZE;
+        blockPtr += shiftWithinBlock;
+        *filePositionAddress = blockPtr;
+    }
+    else 
+    {
+        return -1;
+    }
+
+    return RD_BLOCK_SIZE - shiftWithinBlock;
+}
+
+//counts the runs of adjacent data blocks a file is stored in, 1 for a
+//file in one piece; the caller holds the inode locked
+int countFileExtents(inode* node)
+{
+    char* blockAddress;
+    char* previousEnd;
+    int position, extents;
+
+    extents = 0;
+    previousEnd = NULL;
+    for (position = 0; position < node->size; position += RD_BLOCK_SIZE)
+    {
+        mapFilepositionToMemAddr(node, position, &blockAddress);
+        if (blockAddress != previousEnd)
+        {
+            extents++;
+        }
+        previousEnd = blockAddress + RD_BLOCK_SIZE;
+    }
+    return extents;
+}
+
+
+// Returns the file descriptor index of pathname given a pointer to the
+// file descriptor node containing a file descriptor table.
+int findFileDescriptorIndexByPathname(fileDescriptorNode* pointer, char* pathname) {
+    int i;
+    int parentInodeNumber;
+    int fileInodeNumber;
+    char* fileName;
+    char* parents;
+    char* inodePointer;
+    inode inodePtr;
+    
+    fileName = parents = inodePointer = NULL;
+
+    if (parse(pathname, &parents, &fileName) == -1) 
+    {
+        return -1;
+    }
+
+    parentInodeNumber = getDirInodeNumber(parents, FALSE);
+    if (parentInodeNumber == -1) 
+    {
+        freePath(parents);
+        return -1;
+    }
+    fileInodeNumber = isDirEntry(parentInodeNumber, fileName, "reg");
+    unlockInode(parentInodeNumber, FALSE);
+    freePath(parents);
+    inodePtr = inodeArray[fileInodeNumber];
+    inodePointer = (char*) &inodePtr;
+    for (i = 0; i < MAX_FILES_OPEN; i++) 
+    {
+        if ((char*) pointer->fileDescriptorTable[i].inodePointer == inodePointer)
+        {
+                return i;
+        }
+    }
+    return -1;
+}
+
+
+int isFileInFDProcessList(char* inodePointer) 
+{
+    int i;
+    fileDescriptorNode* trav = fileDescriptorProcessList;
+    while(trav) 
+    {
+        for(i = 0; i < MAX_FILES_OPEN; i++) 
+        {
+            if (trav->fileDescriptorTable[i].filePosition > -1) 
+            {
+                    if ((char*) trav->fileDescriptorTable[i].inodePointer == inodePointer) 
+                    {
+                        return -1;
+                    }
+            }
+            else 
+            {
+                break;
+            }
+        }
+        trav = trav->next;
+    }
+
+    return 0;
+}
+
+//adds a new inode of type named fileName to the directory parentInodeNum,
+//which the caller holds write locked; returns the new inode number or -1
+int createInDir(int parentInodeNum, char* fileName, char* type) 
+{
+    int i;
+    int freeInodeNum;
+    dirEntry* freeDirEntry;
+
+    freeInodeNum = 0;
+    spin_lock(&allocLock);
+    if (sb->freeInodes <= 0) 
+    {
+        spin_unlock(&allocLock);
+        rdStatInc(RD_STAT_ERR_NOSPC);
+        return -1;
+    }
+
+    if (sb->freeBlocks <= 0) 
+    {
+        spin_unlock(&allocLock);
+        rdStatInc(RD_STAT_ERR_NOSPC);
+        return -1;
+    }
+
+    for (i = 1; i < INODE_COUNT; i++) 
+    {   //find free inode
+        if (inodeArray[i].status == FREE) 
+        {
+            freeInodeNum = i;
+            break;
+        }
+    }
+    //claim the inode, nobody else can reach it until it is in the directory
+    sb->freeInodes--;
+    inodeArray[freeInodeNum].status = ALLOCATED;
+    spin_unlock(&allocLock);
+
+    strcpy(inodeArray[freeInodeNum].type, type);
+    inodeArray[freeInodeNum].size = 0;
+    inodeArray[freeInodeNum].flags = 0;
+    inodeArray[freeInodeNum].mapCount = 0;
+    inodeArray[freeInodeNum].openCount = 0;
+    inodeArray[freeInodeNum].location[0] = getFreeBlock();
+    inodeArray[freeInodeNum].locationCount = 1;
+    
+    //update parent by undating inode dirEntry size and dir entries; lockless
+    //lookups retry if they overlap with the change
+    freeDirEntry = NULL;
+    beginInodeChange(&inodeArray[parentInodeNum]);
+    if (inodeArray[freeInodeNum].location[0] != NULL) 
+    {
+        freeDirEntry = (dirEntry*)getFreeDirEntry(parentInodeNum);
+    }
+    if (freeDirEntry != NULL) 
+    {
+        inodeArray[parentInodeNum].size += DIR_ENTRY_STRUCTURE_SIZE;
+        strcpy(freeDirEntry->fileName, fileName);
+        freeDirEntry->inodeNumber = freeInodeNum;
+    }
+    endInodeChange(&inodeArray[parentInodeNum]);
+
+    if (freeDirEntry == NULL) 
+    {
+        freeInodeBlocks(&inodeArray[freeInodeNum]);
+        spin_lock(&allocLock);
+        inodeArray[freeInodeNum].status = FREE;
+        sb->freeInodes++;
+        spin_unlock(&allocLock);
+        return -1;
+    }
+    return freeInodeNum;
+}
+
+//pass in path and type; the new inode number is stored in inodeNumber
+int create(char* pathname, char* type, int* inodeNumber) {
+    int parentInodeNum;
+    char* fileName;
+
+    //check all parents inodes
+    parentInodeNum = validateFile(pathname, type);
+    //get filename
+    fileName = strrchr(pathname, '/');
+    fileName++;
+
+    if (parentInodeNum == -1) 
+    {
+        return -1;
+    }
+
+    *inodeNumber = createInDir(parentInodeNum, fileName, type);
+    if (*inodeNumber == -1) 
+    {
+        unlockInode(parentInodeNum, TRUE);
+        return -1;
+    }
+
+    unlockInode(parentInodeNum, TRUE);
+    return 1;
+}
+
+//regular
+int ram_creat(char* pathname) 
+{
+    int ret, inodeNumber;
+
+    rdStatInc(RD_STAT_CREAT);
+    rdDebug("create file %s\n", pathname);
+    trace_ramdisk_op_enter(RD_STAT_CREAT, -1, -1, 0, 0);
+    ret = -1;
+    inodeNumber = -1;
+    if (beginMutation() != -1) 
+    {
+        ret = create(pathname, "reg", &inodeNumber);
+        endMutation();
+    }
+    trace_ramdisk_op_exit(RD_STAT_CREAT, inodeNumber, ret);
+    return ret;
+}
+
+//dir
+int ram_mkdir(char* pathname) 
+{
+    int ret, inodeNumber;
+
+    rdStatInc(RD_STAT_MKDIR);
+    rdDebug("create dir %s\n", pathname);
+    trace_ramdisk_op_enter(RD_STAT_MKDIR, -1, -1, 0, 0);
+    ret = -1;
+    inodeNumber = -1;
+    if (beginMutation() != -1) 
+    {
+        ret = create(pathname, "dir", &inodeNumber);
+        endMutation();
+    }
+    trace_ramdisk_op_exit(RD_STAT_MKDIR, inodeNumber, ret);
+    return ret;
+}
+
+//open file return fd
+static int openPath(char* pathname, int* inodeNumber) {
+    pathIndex* index;
+    int fileInodeNum;
+    unsigned int generation;
+    int fd;
+    int pid = rdCurrentPid();
+    
+    rdStatInc(RD_STAT_OPEN);
+    //check pathname
+    if (strcmp(pathname, "/") == 0) 
+    {
+        fd = createFileDescriptor(pid, 0);  
+        if (fd == -1) 
+        {
+            rdStatInc(RD_STAT_ERR_MFILE);
+            return -1;
+        }
+        *inodeNumber = 0;
+        return fd;
+    }
+
+    for (;;) 
+    {
+        //a frozen filesystem answers from its path index
+        fileInodeNum = -1;
+        rcu_read_lock();
+        index = rcu_dereference(frozenIndex);
+        if (index) 
+        {
+            fileInodeNum = lookupFrozenPath(index, pathname, "ign");
+            if (fileInodeNum != -1) 
+            {
+                generation = inodeGenerations[fileInodeNum];
+            }
+        }
+        rcu_read_unlock();
+
+        //resolve without locks
+        if (fileInodeNum == -1) 
+        {
+            fileInodeNum = lookupPath(pathname, "ign", &generation);
+        }
+        
+        //check file inode
+        if (fileInodeNum == -1) 
+        {
+            rdDebug("fail to open file %s\n", pathname);
+            rdStatInc(RD_STAT_ERR_NOENT);
+            return -1;
+        }
+        //create entry in the fdt with pid and return fd
+        fd = createFileDescriptor(pid, fileInodeNum);
+        if (fd == -1) 
+        {
+            rdStatInc(RD_STAT_ERR_MFILE);
+            return -1;
+        }
+
+        //an unlink that got in first, or after a thaw, has changed the
+        //generation
+        smp_mb();
+        if (ACCESS_ONCE(inodeGenerations[fileInodeNum]) == generation) 
+        {
+            *inodeNumber = fileInodeNum;
+            return fd;
+        }
+        ram_close(fd);
+    }
+}
+
+int ram_open(char* pathname) 
+{
+    int ret, inodeNumber;
+
+    trace_ramdisk_op_enter(RD_STAT_OPEN, -1, -1, 0, 0);
+    inodeNumber = -1;
+    ret = openPath(pathname, &inodeNumber);
+    trace_ramdisk_op_exit(RD_STAT_OPEN, inodeNumber, ret);
+    return ret;
+}
+
+//close a file, remove fd, return 0 for success
+static int closeFd(int fd) {
+    rdStatInc(RD_STAT_CLOSE);
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    fileDescriptorNode* fdClose = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+
+    if (fdClose == NULL) {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    if (fdClose->fileDescriptorTable[fd].inodePointer == NULL) {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    if (fdClose->mmapInode == fdClose->fileDescriptorTable[fd].inodePointer) 
+    {
+        unselectMapping(fdClose);
+    }
+    fdClose->fileDescriptorTable[fd].filePosition = -1;
+    fdClose->fileDescriptorTable[fd].inodePointer = NULL;
+
+    rdDebug("succeed to close fd\n");
+    return 0;
+}
+
+int ram_close(int fd) 
+{
+    int ret, inodeNumber;
+
+    //the descriptor may be gone by the exit, close clears it
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_CLOSE, fd, inodeNumber, 0, 0);
+    ret = closeFd(fd);
+    trace_ramdisk_op_exit(RD_STAT_CLOSE, inodeNumber, ret);
+    return ret;
+}
+
+//copies up to num_bytes starting at position into address, stopping at the
+//end of the file; returns the number of bytes read
+int readFromInode(inode* inodePointer, int position, char* address, int num_bytes) 
+{
+    char* filePositionAddress;
+    int readableBytes, bytesToRead, totalBytesRead;
+
+    totalBytesRead = 0;
+
+    //only read exist bytes
+    if (position >= inodePointer->size) 
+    {
+        return 0;
+    }
+    if (num_bytes > inodePointer->size - position) 
+    {
+        num_bytes = inodePointer->size - position;
+    }
+
+    while (num_bytes > 0) 
+    {
+        filePositionAddress = NULL;
+        readableBytes = mapFilepositionToMemAddr(inodePointer, position, &filePositionAddress);
+        bytesToRead = getMin(readableBytes, num_bytes);
+
+        memcpy(address, filePositionAddress, bytesToRead);
+
+        address += bytesToRead;
+        num_bytes -= bytesToRead;
+        totalBytesRead += bytesToRead;
+        position += bytesToRead;
+    }
+    return totalBytesRead;
+}
+
+//readFromInode for files within the direct blocks, without any lock: the
+//copy is retried while a writer changes the file; fileSize receives the
+//size it was copied at, and -2 means the file is too large or in flux
+//and has to be read under the inode lock
+int readSmallInode(inode* inodePointer, int position, char* address, int num_bytes, int* fileSize) 
+{
+    seqcount_t* seq;
+    unsigned int start;
+    char* blockAddress;
+    int size, offset, chunk, ret;
+
+    seq = &inodeSeqs[inodePointer->inodeNumber];
+    do 
+    {
+        start = read_seqcount_begin(seq);
+        size = ACCESS_ONCE(inodePointer->size);
+        if (size > DIRECT_LIMIT) 
+        {
+            return -2;
+        }
+
+        ret = 0;
+        if (position < size && num_bytes > 0) 
+        {
+            ret = getMin(num_bytes, size - position);
+        }
+
+        for (offset = 0; offset < ret; offset += chunk) 
+        {
+            blockAddress = ACCESS_ONCE(inodePointer->location[(position + offset) / RD_BLOCK_SIZE]);
+            if (!blockAddress) 
+            {
+                return -2;
+            }
+            chunk = getMin(RD_BLOCK_SIZE - (position + offset) % RD_BLOCK_SIZE, ret - offset);
+            memcpy(address + offset, blockAddress + (position + offset) % RD_BLOCK_SIZE, chunk);
+        }
+    } while (read_seqcount_retry(seq, start));
+
+    *fileSize = size;
+    return ret;
+}
+
+//readFromInode without any lock while the filesystem is frozen; returns -2
+//if it is not
+int readFrozenInode(inode* inodePointer, int position, char* address, int num_bytes) 
+{
+    int ret;
+
+    ret = -2;
+    rcu_read_lock();
+    if (rcu_dereference(frozenIndex)) 
+    {
+        ret = readFromInode(inodePointer, position, address, num_bytes);
+    }
+    rcu_read_unlock();
+    return ret;
+}
+
+//read num_bytes from file by fd, store content in address
+static int readFd(int fd, char* address, int num_bytes) {
+    fileDescriptorNode* fdRead;
+    inode* inodePointer;
+    int ret;
+    int fileSize;
+    rdStatInc(RD_STAT_READ);
+    //check file
+    if (fd < 0 || fd >= MAX_FILES_OPEN) {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    fdRead = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+
+    if (fdRead == NULL || fdRead->fileDescriptorTable[fd].inodePointer == NULL) 
+    {
+        rdDebug("fail to open the file\n");
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    //get inode
+    inodePointer = fdRead->fileDescriptorTable[fd].inodePointer;
+
+    ret = readFrozenInode(inodePointer, fdRead->fileDescriptorTable[fd].filePosition, address, num_bytes);
+    if (ret == -2) 
+    {
+        ret = readSmallInode(inodePointer, fdRead->fileDescriptorTable[fd].filePosition, address, num_bytes, &fileSize);
+    }
+    if (ret == -2) 
+    {
+        lockInode(inodePointer->inodeNumber, FALSE);
+        ret = -1;
+        if (!isStaleDescriptor(&fdRead->fileDescriptorTable[fd])) 
+        {
+            ret = readFromInode(inodePointer, fdRead->fileDescriptorTable[fd].filePosition, address, num_bytes);
+        }
+        unlockInode(inodePointer->inodeNumber, FALSE);
+    }
+    else 
+    {
+        smp_rmb();
+        if (isStaleDescriptor(&fdRead->fileDescriptorTable[fd])) 
+        {
+            ret = -1;
+        }
+    }
+    if (ret == -1) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    //update file position
+    fdRead->fileDescriptorTable[fd].filePosition += ret;
+    rdStatAdd(RD_STAT_BYTES_READ, ret);
+    return ret;
+}
+
+int ram_read(int fd, char* address, int num_bytes) 
+{
+    int ret, inodeNumber;
+
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_READ, fd, inodeNumber, -1, num_bytes);
+    ret = readFd(fd, address, num_bytes);
+    trace_ramdisk_op_exit(RD_STAT_READ, inodeNumber, ret);
+    return ret;
+}
+
+//writes num_bytes at position, adding blocks as the file grows;
+//returns the number of bytes written or -1
+int writeInodeRange(inode* inodePointer, int position, char* address, int num_bytes) 
+{
+    char* filePositionAddress;
+    int totalBytesWritten;
+    int writeableBytes;
+    int bytesToWrite;
+
+    totalBytesWritten = 0;
+
+    while (num_bytes > 0) 
+    {
+        //add block if more than file size
+        if ((position % RD_BLOCK_SIZE == 0) && (position == inodePointer->size) && (inodePointer->size != 0)) 
+        {
+            if (position == MAX_FILE_SIZE) 
+            {
+                return -1;
+            }
+            if (!allocateBlock(inodePointer)) 
+            {
+                return -1;
+            }
+        }
+
+        filePositionAddress = NULL;
+        writeableBytes = mapFilepositionToMemAddr(inodePointer, position, &filePositionAddress);
+        if (filePositionAddress == NULL) 
+        {
+            return -1;
+        }
+        bytesToWrite = getMin(writeableBytes, num_bytes);
+
+        memcpy(filePositionAddress, address, bytesToWrite);
+        address += bytesToWrite;
+        num_bytes -= bytesToWrite;
+        totalBytesWritten += bytesToWrite;
+        position += bytesToWrite;
+        //overwrites inside the file do not grow it
+        if (position > inodePointer->size) 
+        {
+            inodePointer->size = position;
+        }
+    }
+
+    return totalBytesWritten;
+}
+
+//writeInodeRange for the holder of the inode write lock; the part within
+//the direct blocks is written as one change for readSmallInode, the rest
+//cannot affect it since those readers give up on files of that size
+int writeToInode(inode* inodePointer, int position, char* address, int num_bytes) 
+{
+    int head, ret;
+
+    //files have no holes
+    if (position > inodePointer->size) 
+    {
+        return -1;
+    }
+
+    head = 0;
+    if (position < DIRECT_LIMIT) 
+    {
+        head = getMin(num_bytes, DIRECT_LIMIT - position);
+        beginInodeChange(inodePointer);
+        ret = writeInodeRange(inodePointer, position, address, head);
+        endInodeChange(inodePointer);
+        if (ret != head) 
+        {
+            return ret;
+        }
+    }
+
+    if (num_bytes <= head) 
+    {
+        return head;
+    }
+
+    ret = writeInodeRange(inodePointer, position + head, address + head, num_bytes - head);
+    if (ret == -1) 
+    {
+        return -1;
+    }
+    return head + ret;
+}
+
+//write num_bytes into file by fd
+static int writeFd(int fd, char *address, int num_bytes) 
+{
+    fileDescriptorNode* fdWrite;
+    inode* inodePointer;
+    int ret;
+
+    rdStatInc(RD_STAT_WRITE);
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    fdWrite = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+
+    if (fdWrite == NULL || fdWrite->fileDescriptorTable[fd].inodePointer == NULL) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    inodePointer = fdWrite->fileDescriptorTable[fd].inodePointer;
+
+    if (beginMutation() == -1) 
+    {
+        return -1;
+    }
+    lockInode(inodePointer->inodeNumber, TRUE);
+    if (isStaleDescriptor(&fdWrite->fileDescriptorTable[fd])) 
+    {
+        unlockInode(inodePointer->inodeNumber, TRUE);
+        endMutation();
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    ret = writeToInode(inodePointer, fdWrite->fileDescriptorTable[fd].filePosition, address, num_bytes);
+    unlockInode(inodePointer->inodeNumber, TRUE);
+    endMutation();
+    if (ret > 0) 
+    {
+        fdWrite->fileDescriptorTable[fd].filePosition += ret;
+        rdStatAdd(RD_STAT_BYTES_WRITTEN, ret);
+    }
+
+    return ret;
+}
+
+int ram_write(int fd, char *address, int num_bytes) 
+{
+    int ret, inodeNumber;
+
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_WRITE, fd, inodeNumber, -1, num_bytes);
+    ret = writeFd(fd, address, num_bytes);
+    trace_ramdisk_op_exit(RD_STAT_WRITE, inodeNumber, ret);
+    return ret;
+}
+
+//read num_bytes at offset without using or moving the file position
+static int preadFd(int fd, char* address, int num_bytes, int offset) 
+{
+    fileDescriptorNode* fdRead;
+    inode* inodePointer;
+    int ret;
+    int fileSize;
+
+    rdStatInc(RD_STAT_READ);
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    if (offset < 0) 
+    {
+        return -1;
+    }
+
+    fdRead = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+
+    if (fdRead == NULL || fdRead->fileDescriptorTable[fd].inodePointer == NULL) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    inodePointer = fdRead->fileDescriptorTable[fd].inodePointer;
+
+    ret = readFrozenInode(inodePointer, offset, address, num_bytes);
+    if (ret == -2) 
+    {
+        ret = readSmallInode(inodePointer, offset, address, num_bytes, &fileSize);
+    }
+    if (ret == -2) 
+    {
+        lockInode(inodePointer->inodeNumber, FALSE);
+        ret = -1;
+        if (!isStaleDescriptor(&fdRead->fileDescriptorTable[fd])) 
+        {
+            ret = readFromInode(inodePointer, offset, address, num_bytes);
+        }
+        unlockInode(inodePointer->inodeNumber, FALSE);
+    }
+    else 
+    {
+        smp_rmb();
+        if (isStaleDescriptor(&fdRead->fileDescriptorTable[fd])) 
+        {
+            ret = -1;
+        }
+    }
+    if (ret == -1) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    rdStatAdd(RD_STAT_BYTES_READ, ret);
+    return ret;
+}
+
+int ram_pread(int fd, char* address, int num_bytes, int offset) 
+{
+    int ret, inodeNumber;
+
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_READ, fd, inodeNumber, offset, num_bytes);
+    ret = preadFd(fd, address, num_bytes, offset);
+    trace_ramdisk_op_exit(RD_STAT_READ, inodeNumber, ret);
+    return ret;
+}
+
+//write num_bytes at offset without using or moving the file position;
+//the offset may be at most the file size since files have no holes
+static int pwriteFd(int fd, char* address, int num_bytes, int offset) 
+{
+    fileDescriptorNode* fdWrite;
+    inode* inodePointer;
+    int ret;
+
+    rdStatInc(RD_STAT_WRITE);
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    if (offset < 0) 
+    {
+        return -1;
+    }
+
+    fdWrite = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+
+    if (fdWrite == NULL || fdWrite->fileDescriptorTable[fd].inodePointer == NULL) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    inodePointer = fdWrite->fileDescriptorTable[fd].inodePointer;
+    if (strcmp(inodePointer->type, "reg") != 0) 
+    {
+        return -1;
+    }
+
+    if (beginMutation() == -1) 
+    {
+        return -1;
+    }
+    lockInode(inodePointer->inodeNumber, TRUE);
+    if (isStaleDescriptor(&fdWrite->fileDescriptorTable[fd])) 
+    {
+        unlockInode(inodePointer->inodeNumber, TRUE);
+        endMutation();
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    ret = -1;
+    if (offset <= inodePointer->size) 
+    {
+        ret = writeToInode(inodePointer, offset, address, num_bytes);
+    }
+    unlockInode(inodePointer->inodeNumber, TRUE);
+    endMutation();
+    if (ret > 0) 
+    {
+        rdStatAdd(RD_STAT_BYTES_WRITTEN, ret);
+    }
+    return ret;
+}
+
+int ram_pwrite(int fd, char* address, int num_bytes, int offset) 
+{
+    int ret, inodeNumber;
+
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_WRITE, fd, inodeNumber, offset, num_bytes);
+    ret = pwriteFd(fd, address, num_bytes, offset);
+    trace_ramdisk_op_exit(RD_STAT_WRITE, inodeNumber, ret);
+    return ret;
+}
+
+//seek to the offset in a file by fd
+static int seekFd(int fd, int offset) 
+{
+    fileDescriptorNode* fdSeek;
+    int fileSize;
+    rdStatInc(RD_STAT_LSEEK);
+    //check
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    fdSeek = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+
+    if (fdSeek == NULL) 
+    {
+        rdDebug("fail to seek the file\n");
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    //check if the calling process opened the file
+    if (fdSeek->fileDescriptorTable[fd].inodePointer == NULL) 
+    {
+        rdDebug("fail to seek the file\n");
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    if (strcmp(fdSeek->fileDescriptorTable[fd].inodePointer->type, "dir") == 0) 
+    {
+        rdDebug("fail to seek the file\n");
+        return -1;
+    }
+
+    lockInode(fdSeek->fileDescriptorTable[fd].inodePointer->inodeNumber, FALSE);
+    fileSize = fdSeek->fileDescriptorTable[fd].inodePointer->size;
+    if (isStaleDescriptor(&fdSeek->fileDescriptorTable[fd])) 
+    {
+        fileSize = -1;
+    }
+    unlockInode(fdSeek->fileDescriptorTable[fd].inodePointer->inodeNumber, FALSE);
+    if (fileSize == -1) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    //check offset
+    if (offset < 0) 
+    {
+        offset = 0;
+    }
+
+    if (offset > fileSize) 
+    {
+        fdSeek->fileDescriptorTable[fd].filePosition = fileSize;
+    }
+
+    else 
+    {
+        fdSeek->fileDescriptorTable[fd].filePosition = offset;
+    }
+
+    return 0;
+}
+
+int ram_lseek(int fd, int offset) 
+{
+    int ret, inodeNumber;
+
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_LSEEK, fd, inodeNumber, offset, 0);
+    ret = seekFd(fd, offset);
+    trace_ramdisk_op_exit(RD_STAT_LSEEK, inodeNumber, ret);
+    return ret;
+}
+
+//gives back the blocks and the inode of a file out of every directory;
+//the caller holds it write locked inside beginMutation, and the lock is
+//released on return
+void freeUnlinkedInode(int inodeNumber) 
+{
+    //release all blocks, getFreeBlock zeroes them on reuse
+    beginInodeChange(&inodeArray[inodeNumber]);
+    freeInodeBlocks(&inodeArray[inodeNumber]);
+
+    inodeArray[inodeNumber].inodeNumber = inodeNumber;
+    inodeArray[inodeNumber].size = 0;
+    inodeArray[inodeNumber].flags = 0;
+    strcpy(inodeArray[inodeNumber].type, "nil");
+    endInodeChange(&inodeArray[inodeNumber]);
+    unlockInode(inodeNumber, TRUE);
+
+    //only now may createInDir hand the inode out again
+    spin_lock(&allocLock);
+    inodeArray[inodeNumber].status = FREE;
+    sb->freeInodes += 1;
+    spin_unlock(&allocLock);
+}
+
+//removes fileName from directory parentInodeNum, which the caller has
+//write locked inside beginMutation; the lock is released on return.
+//A file that is still open fails, unless deferOpen is set: it is then
+//taken out of the directory now, flagged INODE_FLAG_UNLINKED, and the
+//caller frees it with freeUnlinkedInode on its last close.
+//Returns the inode number the file had, or -1
+int unlinkFromDir(int parentInodeNum, char* fileName, int deferOpen) 
+{
+    int deferred;
+    int fileInodeNum;
+    char* fileType;
+    int deletedInodeNum;
+    int isDir;
+    retiredBlocks retired;
+
+    fileInodeNum = isDirEntry(parentInodeNum, fileName, "ign");
+    if (fileInodeNum == -1) 
+    {
+        unlockInode(parentInodeNum, TRUE);
+        rdStatInc(RD_STAT_ERR_NOENT);
+        return -1;
+    }
+    //waits out readers and writers still using the file through a descriptor
+    lockInode(fileInodeNum, TRUE);
+   
+    fileType = inodeArray[fileInodeNum].type;
+    isDir = strcmp(fileType, "dir") == 0;
+     //unlink non-empty directory
+    if (isDir && inodeArray[fileInodeNum].size != 0) 
+    {
+        rdDebug("fail to unlink: the dir is not null\n");
+        rdStatInc(RD_STAT_ERR_BUSY);
+        unlockInode(fileInodeNum, TRUE);
+        unlockInode(parentInodeNum, TRUE);
+        return -1;
+    }
+    //a mapped or opened file keeps its blocks until it is let go
+    deferred = deferOpen && inodeArray[fileInodeNum].openCount > 0;
+    if (inodeArray[fileInodeNum].mapCount > 0 || (inodeArray[fileInodeNum].openCount > 0 && !deferred)) 
+    {
+        rdDebug("fail to unlink: the file is in use\n");
+        rdStatInc(RD_STAT_ERR_BUSY);
+        unlockInode(fileInodeNum, TRUE);
+        unlockInode(parentInodeNum, TRUE);
+        return -1;
+    }
+    //delete entry from parent; lockless lookups retry if they overlap
+    retired.count = 0;
+    beginInodeChange(&inodeArray[parentInodeNum]);
+    deletedInodeNum = unlinkHelper(parentInodeNum, fileName, inodeArray[fileInodeNum].type, &retired);
+    inodeArray[parentInodeNum].size -= DIR_ENTRY_STRUCTURE_SIZE;
+    endInodeChange(&inodeArray[parentInodeNum]);
+
+    //lookups that found the inode before this fail their generation check
+    inodeGenerations[deletedInodeNum]++;
+    unlockInode(parentInodeNum, TRUE);
+
+    //lockless lookups may still be searching the blocks taken out of the
+    //parent, or those of the directory itself
+    if (retired.count > 0 || isDir) 
+    {
+        synchronize_rcu();
+    }
+    freeRetiredBlocks(&retired);
+
+    if (deferred) 
+    {
+        inodeArray[deletedInodeNum].flags |= INODE_FLAG_UNLINKED;
+        unlockInode(fileInodeNum, TRUE);
+    }
+    else 
+    {
+        freeUnlinkedInode(deletedInodeNum);
+    }
+
+    rdDebug("unlink %s\n", fileName);
+    return deletedInodeNum;
+}
+
+//remove file by pathname; the inode it had is stored in inodeNumber
+static int unlinkPath(char* pathname, int* inodeNumber) {
+    char* parents;
+    char* fileName;
+    int parentInodeNum;
+    //check if root
+    if (strcmp(pathname, "/") == 0) 
+    {
+        rdDebug("fail to unlink root dir\n");
+        rdStatInc(RD_STAT_ERR_BUSY);
+        return -1;
+    }
+    //parse into parent and file name
+    if (parse(pathname, &parents, &fileName) == -1) 
+    {
+        return -1;
+    }
+    //get parent inode; its write lock serializes entry changes
+    parentInodeNum = getDirInodeNumber(parents, TRUE);
+    if (parentInodeNum == -1) 
+    {
+        freePath(parents);
+        rdStatInc(RD_STAT_ERR_NOENT);
+        return -1;
+    }
+
+    *inodeNumber = unlinkFromDir(parentInodeNum, fileName, FALSE);
+    freePath(parents);
+    return *inodeNumber == -1 ? -1 : 0;
+}
+
+int ram_unlink(char* pathname) 
+{
+    int ret, inodeNumber;
+
+    rdStatInc(RD_STAT_UNLINK);
+    trace_ramdisk_op_enter(RD_STAT_UNLINK, -1, -1, 0, 0);
+    ret = -1;
+    inodeNumber = -1;
+    if (beginMutation() != -1) 
+    {
+        ret = unlinkPath(pathname, &inodeNumber);
+        endMutation();
+    }
+    trace_ramdisk_op_exit(RD_STAT_UNLINK, inodeNumber, ret);
+    return ret;
+}
+
+static int readDirFd(int fd, char* address) 
+{
+    char* filePositionMemAddress;
+    int ret;
+    fileDescriptorNode* fdReadDir;
+    fileDescriptorEntry fd_entry;
+    int filePosition;
+    inode* inodePointer;
+    int frozen;
+
+    rdStatInc(RD_STAT_READDIR);
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    fdReadDir = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (fdReadDir == NULL || fdReadDir->fileDescriptorTable[fd].inodePointer == NULL) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+    fd_entry = fdReadDir->fileDescriptorTable[fd];
+    filePosition = fd_entry.filePosition;
+
+    inodePointer = fd_entry.inodePointer;
+
+    //a frozen directory cannot change, the RCU read section only holds off
+    //a thaw
+    rcu_read_lock();
+    frozen = rcu_dereference(frozenIndex) != NULL;
+    if (!frozen) 
+    {
+        rcu_read_unlock();
+        lockInode(inodePointer->inodeNumber, FALSE);
+    }
+
+    ret = 1;
+    if (isStaleDescriptor(&fd_entry)) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        ret = -1;
+    }
+    else if (inodePointer->size == 0) 
+    {
+        rdDebug("there is no file in the dir\n");
+        ret = 0;
+    }
+    else if (filePosition >= inodePointer->size) 
+    {
+        rdDebug("fail to read the dir\n");
+        ret = 0;
+    }
+    else 
+    {
+        mapFilepositionToMemAddr(inodePointer, filePosition, &filePositionMemAddress);
+        memcpy(address, filePositionMemAddress, DIR_ENTRY_STRUCTURE_SIZE);
+    }
+
+    if (frozen) 
+    {
+        rcu_read_unlock();
+    }
+    else 
+    {
+        unlockInode(inodePointer->inodeNumber, FALSE);
+    }
+
+    if (ret == 1) 
+    {
+        fdReadDir->fileDescriptorTable[fd].filePosition += DIR_ENTRY_STRUCTURE_SIZE;
+    }
+    return ret;
+}
+
+int ram_readdir(int fd, char* address) 
+{
+    int ret, inodeNumber;
+
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_READDIR, fd, inodeNumber, -1, DIR_ENTRY_STRUCTURE_SIZE);
+    ret = readDirFd(fd, address);
+    trace_ramdisk_op_exit(RD_STAT_READDIR, inodeNumber, ret);
+    return ret;
+}
+
+//drops the contents of a file, leaving it with one empty block; the caller
+//holds the inode write locked
+int truncateInode(inode* node) 
+{
+    //mapped pages must stay backed
+    if (node->mapCount > 0) 
+    {
+        return -1;
+    }
+
+    freeInodeBlocks(node);
+    node->size = 0;
+    node->location[0] = getDataBlock(node, 0);
+    if (node->location[0] == NULL) 
+    {
+        return -1;
+    }
+    node->locationCount = 1;
+    return 0;
+}
+
+//reads the regular file at pathname into address without opening it;
+//copies at most num_bytes and returns the file size, storing its inode
+//number in inodeNumber
+static int readPath(char* pathname, char* address, int num_bytes, int* inodeNumber) 
+{
+    pathIndex* index;
+    int fileInodeNum;
+    int size;
+    unsigned int generation;
+
+    rdStatInc(RD_STAT_READFILE);
+    //nothing changes while frozen, so any file is copied without a lock
+    rcu_read_lock();
+    index = rcu_dereference(frozenIndex);
+    if (index) 
+    {
+        fileInodeNum = lookupFrozenPath(index, pathname, "reg");
+        if (fileInodeNum != -1) 
+        {
+            readFromInode(&inodeArray[fileInodeNum], 0, address, num_bytes);
+            size = inodeArray[fileInodeNum].size;
+            rcu_read_unlock();
+            *inodeNumber = fileInodeNum;
+            return size;
+        }
+    }
+    rcu_read_unlock();
+
+    //small files are copied without any lock; the generation tells whether
+    //the file was unlinked after the lookup
+    fileInodeNum = lookupPath(pathname, "reg", &generation);
+    if (fileInodeNum == -1) 
+    {
+        rdStatInc(RD_STAT_ERR_NOENT);
+        return -1;
+    }
+    if (readSmallInode(&inodeArray[fileInodeNum], 0, address, num_bytes, &size) != -2) 
+    {
+        smp_rmb();
+        if (ACCESS_ONCE(inodeGenerations[fileInodeNum]) == generation) 
+        {
+            *inodeNumber = fileInodeNum;
+            return size;
+        }
+    }
+
+    fileInodeNum = lockPathInode(pathname, "reg", FALSE);
+    if (fileInodeNum == -1) 
+    {
+        return -1;
+    }
+
+    readFromInode(&inodeArray[fileInodeNum], 0, address, num_bytes);
+    size = inodeArray[fileInodeNum].size;
+    unlockInode(fileInodeNum, FALSE);
+    *inodeNumber = fileInodeNum;
+    return size;
+}
+
+int ram_readfile(char* pathname, char* address, int num_bytes) 
+{
+    int ret, inodeNumber;
+
+    trace_ramdisk_op_enter(RD_STAT_READFILE, -1, -1, 0, num_bytes);
+    inodeNumber = -1;
+    ret = readPath(pathname, address, num_bytes, &inodeNumber);
+    trace_ramdisk_op_exit(RD_STAT_READFILE, inodeNumber, ret);
+    return ret;
+}
+
+//replaces the contents of the regular file at pathname with num_bytes from
+//address, creating it if needed, without opening it; the file's inode
+//number is stored in inodeNumber
+static int replaceFile(char* pathname, char* address, int num_bytes, int* inodeNumber) 
+{
+    int parentInodeNum;
+    int fileInodeNum;
+    int truncate;
+    int head;
+    int ret;
+    inode* node;
+
+    //the parent is write locked in case the file has to be created
+    fileInodeNum = getInodeNumber(pathname, "reg", &parentInodeNum, TRUE);
+    if (parentInodeNum == -1) 
+    {
+        return -1;
+    }
+    if (fileInodeNum == -1) 
+    {
+        if (isDirEntry(parentInodeNum, strrchr(pathname, '/') + 1, "ign") != -1) 
+        {
+            unlockInode(parentInodeNum, TRUE);
+            return -1;
+        }
+        fileInodeNum = createInDir(parentInodeNum, strrchr(pathname, '/') + 1, "reg");
+        if (fileInodeNum == -1) 
+        {
+            unlockInode(parentInodeNum, TRUE);
+            return -1;
+        }
+        lockInode(fileInodeNum, TRUE);
+        unlockInode(parentInodeNum, TRUE);
+        truncate = FALSE;
+    }
+    else 
+    {
+        lockInode(fileInodeNum, TRUE);
+        unlockInode(parentInodeNum, TRUE);
+        //a file that is mapped or open as a struct file is in use, as for
+        //unlinkFromDir
+        if (inodeArray[fileInodeNum].mapCount > 0 || inodeArray[fileInodeNum].openCount > 0) 
+        {
+            rdStatInc(RD_STAT_ERR_BUSY);
+            unlockInode(fileInodeNum, TRUE);
+            return -1;
+        }
+        truncate = TRUE;
+    }
+
+    //the old contents and the new direct blocks are one change to
+    //readSmallInode, so it never sees the file empty in between
+    *inodeNumber = fileInodeNum;
+    node = &inodeArray[fileInodeNum];
+    head = getMin(num_bytes, DIRECT_LIMIT);
+    ret = -1;
+    beginInodeChange(node);
+    if (!truncate || truncateInode(node) != -1) 
+    {
+        ret = writeInodeRange(node, 0, address, head);
+    }
+    //descriptors opened on the old contents go stale as after an unlink,
+    //rather than being left past the end of the new ones
+    if (truncate) 
+    {
+        inodeGenerations[fileInodeNum]++;
+    }
+    endInodeChange(node);
+
+    if (ret == head && num_bytes > head) 
+    {
+        ret = writeInodeRange(node, head, address + head, num_bytes - head);
+        if (ret != -1) 
+        {
+            ret += head;
+        }
+    }
+    unlockInode(fileInodeNum, TRUE);
+    return ret;
+}
+
+int ram_writefile(char* pathname, char* address, int num_bytes) 
+{
+    int ret, inodeNumber;
+
+    rdStatInc(RD_STAT_WRITEFILE);
+    trace_ramdisk_op_enter(RD_STAT_WRITEFILE, -1, -1, 0, num_bytes);
+    ret = -1;
+    inodeNumber = -1;
+    if (beginMutation() != -1) 
+    {
+        ret = replaceFile(pathname, address, num_bytes, &inodeNumber);
+        endMutation();
+    }
+    if (ret > 0) 
+    {
+        rdStatAdd(RD_STAT_BYTES_WRITTEN, ret);
+    }
+    trace_ramdisk_op_exit(RD_STAT_WRITEFILE, inodeNumber, ret);
+    return ret;
+}
+
+//pins the regular file at pathname for a struct file of its own;
+//returns its inode number
+int ram_openfile(char* pathname) 
+{
+    int fileInodeNum;
+
+    rdStatInc(RD_STAT_OPENFILE);
+    trace_ramdisk_op_enter(RD_STAT_OPENFILE, -1, -1, 0, 0);
+    fileInodeNum = lockPathInode(pathname, "reg", TRUE);
+    if (fileInodeNum == -1) 
+    {
+        rdStatInc(RD_STAT_ERR_NOENT);
+        trace_ramdisk_op_exit(RD_STAT_OPENFILE, -1, -1);
+        return -1;
+    }
+
+    inodeArray[fileInodeNum].openCount++;
+    unlockInode(fileInodeNum, TRUE);
+    trace_ramdisk_op_exit(RD_STAT_OPENFILE, fileInodeNum, fileInodeNum);
+    return fileInodeNum;
+}
+
+//indexes the paths, which makes the filesystem read-only; freezeLock is
+//write held
+static int indexFrozen(void) 
+{
+    pathIndex* index;
+
+    index = buildPathIndex();
+    if (!index) 
+    {
+        return -ENOMEM;
+    }
+    rcu_assign_pointer(frozenIndex, index);
+
+    printk("ramdisk frozen, %d paths indexed\n", index->entryCount);
+    return 0;
+}
+
+//lets changes in again and releases freezeLock, which is write held
+static void unfreezeAndUnlock(void) 
+{
+    pathIndex* index;
+
+    index = frozenIndex;
+    rcu_assign_pointer(frozenIndex, NULL);
+
+    //readers that saw the filesystem frozen must be done before a change
+    synchronize_rcu();
+    up_write(&freezeLock);
+
+    freePathIndex(index);
+    printk("ramdisk thawed\n");
+}
+
+//makes the filesystem read-only and indexes its paths; fails if ram_freeze
+//froze it already. An open backup image may have frozen it first, the
+//filesystem then stays frozen until both are done
+static int freezeRamdisk(void) 
+{
+    rdStatInc(RD_STAT_FREEZE);
+    //waits for the changes in flight and keeps new ones out
+    down_write(&freezeLock);
+    if (explicitFreeze || (!frozenIndex && indexFrozen() != 0)) 
+    {
+        up_write(&freezeLock);
+        return -1;
+    }
+    explicitFreeze = TRUE;
+    up_write(&freezeLock);
+    return 0;
+}
+
+int ram_freeze(void) 
+{
+    int ret;
+
+    trace_ramdisk_op_enter(RD_STAT_FREEZE, -1, -1, 0, 0);
+    ret = freezeRamdisk();
+    trace_ramdisk_op_exit(RD_STAT_FREEZE, -1, ret);
+    return ret;
+}
+
+//whether the filesystem is frozen right now
+int isFrozen(void) 
+{
+    return ACCESS_ONCE(frozenIndex) != NULL;
+}
+
+//undoes ram_freeze; fails if it was not frozen that way, or while a backup
+//image is open since a change would tear it
+static int thawRamdisk(void) 
+{
+    rdStatInc(RD_STAT_THAW);
+    down_write(&freezeLock);
+    if (!explicitFreeze) 
+    {
+        up_write(&freezeLock);
+        return -1;
+    }
+    if (freezeHolders > 0) 
+    {
+        up_write(&freezeLock);
+        rdStatInc(RD_STAT_ERR_BUSY);
+        return -1;
+    }
+    explicitFreeze = FALSE;
+    unfreezeAndUnlock();
+    return 0;
+}
+
+int ram_thaw(void) 
+{
+    int ret;
+
+    trace_ramdisk_op_enter(RD_STAT_THAW, -1, -1, 0, 0);
+    ret = thawRamdisk();
+    trace_ramdisk_op_exit(RD_STAT_THAW, -1, ret);
+    return ret;
+}
+
+//keeps the filesystem frozen for a reader of the whole image, freezing it
+//if needed; every hold is given back with releaseFreeze and the last one
+//thaws unless ram_freeze froze it too
+int holdFreeze(void) 
+{
+    int ret;
+
+    down_write(&freezeLock);
+    if (!frozenIndex) 
+    {
+        ret = indexFrozen();
+        if (ret != 0) 
+        {
+            up_write(&freezeLock);
+            return ret;
+        }
+    }
+    freezeHolders++;
+    up_write(&freezeLock);
+    return 0;
+}
+
+void releaseFreeze(void) 
+{
+    down_write(&freezeLock);
+    freezeHolders--;
+    if (freezeHolders == 0 && !explicitFreeze) 
+    {
+        unfreezeAndUnlock();
+        return;
+    }
+    up_write(&freezeLock);
+}
+
+//selects the regular file behind fd for the next mmap of the device,
+//moving it into page-aligned block groups first if needed
+static int mapFd(int fd) 
+{
+    fileDescriptorNode* fdMap;
+    inode* inodePointer;
+    int frozen;
+
+    rdStatInc(RD_STAT_MMAP);
+    if (fd < 0 || fd >= MAX_FILES_OPEN) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    fdMap = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (fdMap == NULL || fdMap->fileDescriptorTable[fd].inodePointer == NULL) 
+    {
+        rdStatInc(RD_STAT_ERR_BADF);
+        return -1;
+    }
+
+    inodePointer = fdMap->fileDescriptorTable[fd].inodePointer;
+
+    //moving the blocks is a change, so a frozen file must be mappable already;
+    //the descriptor and type are checked under the lock since the file may
+    //be unlinked
+    frozen = beginMutation() == -1;
+    lockInode(inodePointer->inodeNumber, TRUE);
+    if (isStaleDescriptor(&fdMap->fileDescriptorTable[fd]) || strcmp(inodePointer->type, "reg") != 0 || 
+        (!(inodePointer->flags & INODE_FLAG_MAPPABLE) && (frozen || relocateToBlockGroups(inodePointer) == -1))) 
+    {
+        unlockInode(inodePointer->inodeNumber, TRUE);
+        if (!frozen) 
+        {
+            endMutation();
+        }
+        rdDebug("fail to map the file\n");
+        return -1;
+    }
+    //the selection pins the file like a mapping does, so it can be neither
+    //unlinked nor truncated before mmap() maps it
+    inodePointer->mapCount++;
+    unlockInode(inodePointer->inodeNumber, TRUE);
+    if (!frozen) 
+    {
+        endMutation();
+    }
+
+    unselectMapping(fdMap);
+    fdMap->mmapInode = inodePointer;
+    return 0;
+}
+
+int ram_mmap(int fd) 
+{
+    int ret, inodeNumber;
+
+    inodeNumber = traceInode(fd);
+    trace_ramdisk_op_enter(RD_STAT_MMAP, fd, inodeNumber, 0, 0);
+    ret = mapFd(fd);
+    trace_ramdisk_op_exit(RD_STAT_MMAP, inodeNumber, ret);
+    return ret;
+}
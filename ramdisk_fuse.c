@@ -0,0 +1,729 @@
+/*
+ * ramdisk_fuse.c - mounts the filesystem core through FUSE
+ * Usage: ramdisk_fuse [FUSE options] <mountpoint>
+ * The core runs in this process, linked from libramdisk.a, and every
+ * request goes straight to the inode-level functions: no paths are built
+ * and the per-task descriptor tables are not used, so any worker thread
+ * can serve any request.
+ */
+
+#define FUSE_USE_VERSION 32
+
+#include <fuse_lowlevel.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <fcntl.h>
+
+#include "ramdisk.h"
+
+// FUSE numbers the root 1, the ramdisk numbers it 0
+#define RD_FUSE_INO(inodeNumber) ((fuse_ino_t) (inodeNumber) + 1)
+#define RD_FUSE_INODE(ino) ((int) (ino) - 1)
+
+// Only this process changes the filesystem, so the kernel may cache freely
+#define RD_FUSE_TIMEOUT 60.0
+
+#define RD_FUSE_MAX_WRITE (128 * 1024)
+
+static uid_t ownerUid;
+static gid_t ownerGid;
+
+//whether ino names an inode that is in use; the caller holds its lock
+static int isLiveInode(int inodeNumber)
+{
+    return inodeNumber >= 0 && inodeNumber < INODE_COUNT && inodeArray[inodeNumber].status == ALLOCATED;
+}
+
+//the caller holds the inode locked
+static void fillStat(int inodeNumber, struct stat* st)
+{
+    inode* node;
+
+    node = &inodeArray[inodeNumber];
+    memset(st, 0, sizeof(struct stat));
+    st->st_ino = RD_FUSE_INO(inodeNumber);
+    if (strcmp(node->type, "dir") == 0)
+    {
+        st->st_mode = S_IFDIR | 0755;
+        st->st_nlink = 2;
+    }
+    else
+    {
+        st->st_mode = S_IFREG | 0644;
+        st->st_nlink = node->flags & INODE_FLAG_UNLINKED ? 0 : 1;
+    }
+    st->st_uid = ownerUid;
+    st->st_gid = ownerGid;
+    st->st_size = node->size;
+    st->st_blksize = RD_BLOCK_SIZE;
+    //data blocks only; locationCount stops counting at the indirect ones
+    st->st_blocks = (((long) node->size + RD_BLOCK_SIZE - 1) / RD_BLOCK_SIZE * RD_BLOCK_SIZE + 511) / 512;
+}
+
+//the caller holds the inode locked
+static void fillEntry(int inodeNumber, struct fuse_entry_param* entry)
+{
+    memset(entry, 0, sizeof(struct fuse_entry_param));
+    entry->ino = RD_FUSE_INO(inodeNumber);
+    entry->generation = inodeGeneration(inodeNumber);
+    entry->attr_timeout = RD_FUSE_TIMEOUT;
+    entry->entry_timeout = RD_FUSE_TIMEOUT;
+    fillStat(inodeNumber, &entry->attr);
+}
+
+//copies a name from the kernel into a directory entry name; returns -1
+//if it does not fit
+static int copyName(const char* name, char* fileName)
+{
+    if (strlen(name) > DIR_ENTRY_FILENAME_SIZE)
+    {
+        return -1;
+    }
+    strcpy(fileName, name);
+    return 0;
+}
+
+static void ramdisk_fuse_init(void* userdata, struct fuse_conn_info* conn)
+{
+    //replies are spliced straight from the blocks, and requests into pipes
+    if (conn->capable & FUSE_CAP_SPLICE_WRITE)
+    {
+        conn->want |= FUSE_CAP_SPLICE_WRITE;
+    }
+    if (conn->capable & FUSE_CAP_SPLICE_READ)
+    {
+        conn->want |= FUSE_CAP_SPLICE_READ;
+    }
+    conn->max_write = RD_FUSE_MAX_WRITE;
+}
+
+static void ramdisk_fuse_lookup(fuse_req_t req, fuse_ino_t parent, const char* name)
+{
+    struct fuse_entry_param entry;
+    char fileName[DIR_ENTRY_FILENAME_SIZE + 1];
+    int parentInodeNum;
+    int fileInodeNum;
+
+    if (copyName(name, fileName) == -1)
+    {
+        fuse_reply_err(req, ENAMETOOLONG);
+        return;
+    }
+
+    //the parent stays locked so the entry cannot go away before its
+    //inode is locked in turn
+    parentInodeNum = RD_FUSE_INODE(parent);
+    lockInode(parentInodeNum, FALSE);
+    fileInodeNum = -1;
+    if (isLiveInode(parentInodeNum))
+    {
+        fileInodeNum = isDirEntry(parentInodeNum, fileName, "ign");
+    }
+    if (fileInodeNum != -1)
+    {
+        lockInode(fileInodeNum, FALSE);
+        fillEntry(fileInodeNum, &entry);
+        unlockInode(fileInodeNum, FALSE);
+    }
+    unlockInode(parentInodeNum, FALSE);
+
+    if (fileInodeNum == -1)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    fuse_reply_entry(req, &entry);
+}
+
+static void ramdisk_fuse_getattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+    struct stat st;
+    int inodeNumber;
+    int live;
+
+    inodeNumber = RD_FUSE_INODE(ino);
+    lockInode(inodeNumber, FALSE);
+    live = isLiveInode(inodeNumber);
+    if (live)
+    {
+        fillStat(inodeNumber, &st);
+    }
+    unlockInode(inodeNumber, FALSE);
+
+    if (!live)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    fuse_reply_attr(req, &st, RD_FUSE_TIMEOUT);
+}
+
+//sets the size of a regular file; files have no holes, so it is rewritten
+//from its first newSize bytes, zero filled; the caller holds it write
+//locked inside beginMutation
+static int resizeInode(inode* node, int newSize)
+{
+    char* contents;
+    int head;
+    int ret;
+
+    contents = (char*) calloc(1, newSize + 1);
+    if (!contents)
+    {
+        return -ENOMEM;
+    }
+    readFromInode(node, 0, contents, newSize);
+
+    //as in ram_writefile, lockless readers see the old contents or the
+    //new head, never an empty file in between
+    head = getMin(newSize, DIRECT_LIMIT);
+    ret = -EBUSY;
+    beginInodeChange(node);
+    if (truncateInode(node) != -1)
+    {
+        ret = writeInodeRange(node, 0, contents, head) == head ? 0 : -ENOSPC;
+    }
+    endInodeChange(node);
+
+    if (ret == 0 && newSize > head && writeInodeRange(node, head, contents + head, newSize - head) != newSize - head)
+    {
+        ret = -ENOSPC;
+    }
+    free(contents);
+    return ret;
+}
+
+//only the size can change; there are no modes, owners or times to keep
+static void ramdisk_fuse_setattr(fuse_req_t req, fuse_ino_t ino, struct stat* attr, int to_set, struct fuse_file_info* fi)
+{
+    struct stat st;
+    inode* node;
+    int inodeNumber;
+    int ret;
+
+    inodeNumber = RD_FUSE_INODE(ino);
+    if (!(to_set & FUSE_SET_ATTR_SIZE))
+    {
+        ramdisk_fuse_getattr(req, ino, fi);
+        return;
+    }
+    if (attr->st_size < 0 || attr->st_size > MAX_FILE_SIZE)
+    {
+        fuse_reply_err(req, EFBIG);
+        return;
+    }
+    if (beginMutation() == -1)
+    {
+        fuse_reply_err(req, EROFS);
+        return;
+    }
+
+    lockInode(inodeNumber, TRUE);
+    node = &inodeArray[inodeNumber];
+    ret = 0;
+    if (!isLiveInode(inodeNumber))
+    {
+        ret = -ENOENT;
+    }
+    else if (strcmp(node->type, "reg") != 0)
+    {
+        ret = -EISDIR;
+    }
+    else if (attr->st_size != node->size)
+    {
+        ret = resizeInode(node, attr->st_size);
+    }
+    if (ret == 0)
+    {
+        fillStat(inodeNumber, &st);
+    }
+    unlockInode(inodeNumber, TRUE);
+    endMutation();
+
+    if (ret < 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+    fuse_reply_attr(req, &st, RD_FUSE_TIMEOUT);
+}
+
+//adds a file or directory named name to parent; a new file is opened
+//into fi as well
+static void makeEntry(fuse_req_t req, fuse_ino_t parent, const char* name, char* type, struct fuse_file_info* fi)
+{
+    struct fuse_entry_param entry;
+    char fileName[DIR_ENTRY_FILENAME_SIZE + 1];
+    int parentInodeNum;
+    int fileInodeNum;
+    int ret;
+
+    if (copyName(name, fileName) == -1)
+    {
+        fuse_reply_err(req, ENAMETOOLONG);
+        return;
+    }
+    if (beginMutation() == -1)
+    {
+        fuse_reply_err(req, EROFS);
+        return;
+    }
+
+    parentInodeNum = RD_FUSE_INODE(parent);
+    lockInode(parentInodeNum, TRUE);
+    ret = 0;
+    if (!isLiveInode(parentInodeNum) || strcmp(inodeArray[parentInodeNum].type, "dir") != 0)
+    {
+        ret = ENOENT;
+    }
+    else if (isDirEntry(parentInodeNum, fileName, "ign") != -1)
+    {
+        ret = EEXIST;
+    }
+    else
+    {
+        fileInodeNum = createInDir(parentInodeNum, fileName, type);
+        if (fileInodeNum == -1)
+        {
+            ret = ENOSPC;
+        }
+        else
+        {
+            lockInode(fileInodeNum, TRUE);
+            if (fi)
+            {
+                inodeArray[fileInodeNum].openCount++;
+                fi->fh = fileInodeNum;
+            }
+            fillEntry(fileInodeNum, &entry);
+            unlockInode(fileInodeNum, TRUE);
+        }
+    }
+    unlockInode(parentInodeNum, TRUE);
+    endMutation();
+
+    if (ret != 0)
+    {
+        fuse_reply_err(req, ret);
+    }
+    else if (fi)
+    {
+        fuse_reply_create(req, &entry, fi);
+    }
+    else
+    {
+        fuse_reply_entry(req, &entry);
+    }
+}
+
+static void ramdisk_fuse_mkdir(fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode)
+{
+    makeEntry(req, parent, name, "dir", NULL);
+}
+
+static void ramdisk_fuse_create(fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode, struct fuse_file_info* fi)
+{
+    makeEntry(req, parent, name, "reg", fi);
+}
+
+//removes name of type from parent; a file that is still open leaves the
+//directory at once and keeps its blocks until its last release
+static void removeEntry(fuse_req_t req, fuse_ino_t parent, const char* name, char* type)
+{
+    char fileName[DIR_ENTRY_FILENAME_SIZE + 1];
+    int parentInodeNum;
+    int fileInodeNum;
+    int isDir;
+    int ret;
+
+    if (copyName(name, fileName) == -1)
+    {
+        fuse_reply_err(req, ENAMETOOLONG);
+        return;
+    }
+    if (beginMutation() == -1)
+    {
+        fuse_reply_err(req, EROFS);
+        return;
+    }
+
+    parentInodeNum = RD_FUSE_INODE(parent);
+    lockInode(parentInodeNum, TRUE);
+    fileInodeNum = -1;
+    if (isLiveInode(parentInodeNum))
+    {
+        fileInodeNum = isDirEntry(parentInodeNum, fileName, "ign");
+    }
+
+    if (fileInodeNum == -1)
+    {
+        unlockInode(parentInodeNum, TRUE);
+        ret = ENOENT;
+    }
+    else
+    {
+        isDir = strcmp(inodeArray[fileInodeNum].type, "dir") == 0;
+        if (isDir != (strcmp(type, "dir") == 0))
+        {
+            unlockInode(parentInodeNum, TRUE);
+            ret = isDir ? EISDIR : ENOTDIR;
+        }
+        else
+        {
+            //unlinkFromDir releases the parent
+            ret = 0;
+            if (unlinkFromDir(parentInodeNum, fileName, TRUE) == -1)
+            {
+                ret = isDir ? ENOTEMPTY : EBUSY;
+            }
+        }
+    }
+    endMutation();
+
+    fuse_reply_err(req, ret);
+}
+
+static void ramdisk_fuse_unlink(fuse_req_t req, fuse_ino_t parent, const char* name)
+{
+    removeEntry(req, parent, name, "reg");
+}
+
+static void ramdisk_fuse_rmdir(fuse_req_t req, fuse_ino_t parent, const char* name)
+{
+    removeEntry(req, parent, name, "dir");
+}
+
+static void ramdisk_fuse_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+    int inodeNumber;
+    int ret;
+
+    inodeNumber = RD_FUSE_INODE(ino);
+    lockInode(inodeNumber, TRUE);
+    ret = 0;
+    if (!isLiveInode(inodeNumber))
+    {
+        ret = ENOENT;
+    }
+    else if (strcmp(inodeArray[inodeNumber].type, "reg") != 0)
+    {
+        ret = EISDIR;
+    }
+    else
+    {
+        inodeArray[inodeNumber].openCount++;
+    }
+    unlockInode(inodeNumber, TRUE);
+
+    if (ret != 0)
+    {
+        fuse_reply_err(req, ret);
+        return;
+    }
+    fi->fh = inodeNumber;
+    fuse_reply_open(req, fi);
+}
+
+//the last release of a file unlinked while open frees it; nothing in this
+//process freezes the filesystem, so the mutation is always let in
+static void ramdisk_fuse_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+    int mutating;
+
+    mutating = beginMutation() != -1;
+    lockInode(fi->fh, TRUE);
+    inodeArray[fi->fh].openCount--;
+    if (mutating && inodeArray[fi->fh].openCount == 0 && (inodeArray[fi->fh].flags & INODE_FLAG_UNLINKED))
+    {
+        //freeUnlinkedInode releases the inode
+        freeUnlinkedInode(fi->fh);
+    }
+    else
+    {
+        unlockInode(fi->fh, TRUE);
+    }
+    if (mutating)
+    {
+        endMutation();
+    }
+    fuse_reply_err(req, 0);
+}
+
+//replies with the blocks themselves: the buffers point into the ramdisk
+//and are copied or spliced out before the read lock is dropped
+static void ramdisk_fuse_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi)
+{
+    struct fuse_bufvec* data;
+    struct fuse_buf* last;
+    inode* node;
+    char* blockAddress;
+    long position, end;
+    int chunk;
+
+    data = (struct fuse_bufvec*) calloc(1, sizeof(struct fuse_bufvec) + sizeof(struct fuse_buf) * (size / RD_BLOCK_SIZE + 2));
+    if (!data)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+
+    node = &inodeArray[fi->fh];
+    lockInode(fi->fh, FALSE);
+    end = off + (long) size;
+    if (end > node->size)
+    {
+        end = node->size;
+    }
+
+    last = NULL;
+    for (position = off; position < end; position += chunk)
+    {
+        chunk = mapFilepositionToMemAddr(node, position, &blockAddress);
+        chunk = getMin(chunk, end - position);
+
+        //blocks that follow each other in memory go out as one buffer
+        if (last && (char*) last->mem + last->size == blockAddress)
+        {
+            last->size += chunk;
+        }
+        else
+        {
+            last = &data->buf[data->count++];
+            last->mem = blockAddress;
+            last->size = chunk;
+        }
+    }
+
+    if (data->count == 0)
+    {
+        fuse_reply_buf(req, NULL, 0);
+    }
+    else
+    {
+        fuse_reply_data(req, data, 0);
+    }
+    unlockInode(fi->fh, FALSE);
+    free(data);
+}
+
+//takes the data out of the request, which may be a pipe when requests
+//are spliced, before any lock is held
+static void ramdisk_fuse_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec* in, off_t off, struct fuse_file_info* fi)
+{
+    struct fuse_bufvec out = FUSE_BUFVEC_INIT(fuse_buf_size(in));
+    inode* node;
+    char* buffer;
+    ssize_t copied;
+    int ret;
+
+    if (off < 0 || off + (long) fuse_buf_size(in) > MAX_FILE_SIZE)
+    {
+        fuse_reply_err(req, EFBIG);
+        return;
+    }
+
+    buffer = (char*) malloc(fuse_buf_size(in) + 1);
+    if (!buffer)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    out.buf[0].mem = buffer;
+    copied = fuse_buf_copy(&out, in, 0);
+    if (copied < 0)
+    {
+        free(buffer);
+        fuse_reply_err(req, -copied);
+        return;
+    }
+
+    if (beginMutation() == -1)
+    {
+        free(buffer);
+        fuse_reply_err(req, EROFS);
+        return;
+    }
+    node = &inodeArray[fi->fh];
+    lockInode(fi->fh, TRUE);
+    //files have no holes
+    ret = -EINVAL;
+    if (off <= node->size)
+    {
+        ret = writeToInode(node, off, buffer, copied);
+        if (ret == -1)
+        {
+            ret = -ENOSPC;
+        }
+    }
+    unlockInode(fi->fh, TRUE);
+    endMutation();
+    free(buffer);
+
+    if (ret < 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+    fuse_reply_write(req, ret);
+}
+
+//the offset of an entry is its index plus one, 0 being the start
+static void ramdisk_fuse_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi)
+{
+    char fileName[DIR_ENTRY_FILENAME_SIZE + 1];
+    struct stat st;
+    dirEntry* child;
+    inode* node;
+    char* buffer;
+    char* entryAddress;
+    size_t used, length;
+    long position;
+    int inodeNumber;
+
+    buffer = (char*) malloc(size);
+    if (!buffer)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+
+    inodeNumber = RD_FUSE_INODE(ino);
+    node = &inodeArray[inodeNumber];
+    used = 0;
+    lockInode(inodeNumber, FALSE);
+    for (position = off * DIR_ENTRY_STRUCTURE_SIZE; isLiveInode(inodeNumber) && position < node->size; position += DIR_ENTRY_STRUCTURE_SIZE)
+    {
+        mapFilepositionToMemAddr(node, position, &entryAddress);
+        child = (dirEntry*) entryAddress;
+
+        memcpy(fileName, child->fileName, DIR_ENTRY_FILENAME_SIZE);
+        fileName[strnlen(child->fileName, DIR_ENTRY_FILENAME_SIZE)] = '\0';
+
+        //only the inode number and the type bits are used
+        memset(&st, 0, sizeof(struct stat));
+        st.st_ino = RD_FUSE_INO(child->inodeNumber);
+        st.st_mode = strcmp(inodeArray[child->inodeNumber].type, "dir") == 0 ? S_IFDIR : S_IFREG;
+
+        length = fuse_add_direntry(req, buffer + used, size - used, fileName, &st, position / DIR_ENTRY_STRUCTURE_SIZE + 1);
+        if (length > size - used)
+        {
+            break;
+        }
+        used += length;
+    }
+    unlockInode(inodeNumber, FALSE);
+
+    fuse_reply_buf(req, buffer, used);
+    free(buffer);
+}
+
+static void ramdisk_fuse_statfs(fuse_req_t req, fuse_ino_t ino)
+{
+    struct statvfs st;
+
+    memset(&st, 0, sizeof(struct statvfs));
+    st.f_bsize = RD_BLOCK_SIZE;
+    st.f_frsize = RD_BLOCK_SIZE;
+    st.f_blocks = RD_BLOCK_COUNT;
+    st.f_bfree = ACCESS_ONCE(sb->freeBlocks);
+    st.f_bavail = st.f_bfree;
+    st.f_files = INODE_COUNT;
+    st.f_ffree = ACCESS_ONCE(sb->freeInodes);
+    st.f_favail = st.f_ffree;
+    st.f_namemax = DIR_ENTRY_FILENAME_SIZE;
+    fuse_reply_statfs(req, &st);
+}
+
+static const struct fuse_lowlevel_ops ramdiskFuseOperations = {
+    .init = ramdisk_fuse_init,
+    .lookup = ramdisk_fuse_lookup,
+    .getattr = ramdisk_fuse_getattr,
+    .setattr = ramdisk_fuse_setattr,
+    .mkdir = ramdisk_fuse_mkdir,
+    .unlink = ramdisk_fuse_unlink,
+    .rmdir = ramdisk_fuse_rmdir,
+    .open = ramdisk_fuse_open,
+    .read = ramdisk_fuse_read,
+    .release = ramdisk_fuse_release,
+    .readdir = ramdisk_fuse_readdir,
+    .statfs = ramdisk_fuse_statfs,
+    .create = ramdisk_fuse_create,
+    .write_buf = ramdisk_fuse_write_buf,
+};
+
+int main(int argc, char* argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_cmdline_opts opts;
+    struct fuse_loop_config config;
+    struct fuse_session* se;
+    int ret;
+
+    if (fuse_parse_cmdline(&args, &opts) != 0)
+    {
+        return 1;
+    }
+    if (opts.show_help)
+    {
+        printf("usage: %s [options] <mountpoint>\n\n", argv[0]);
+        fuse_cmdline_help();
+        fuse_lowlevel_help();
+        free(opts.mountpoint);
+        fuse_opt_free_args(&args);
+        return 0;
+    }
+    if (opts.show_version)
+    {
+        fuse_lowlevel_version();
+        free(opts.mountpoint);
+        fuse_opt_free_args(&args);
+        return 0;
+    }
+    if (!opts.mountpoint)
+    {
+        fprintf(stderr, "usage: %s [options] <mountpoint>\n", argv[0]);
+        fuse_opt_free_args(&args);
+        return 1;
+    }
+
+    ownerUid = getuid();
+    ownerGid = getgid();
+    if (initRamdisk() < 0)
+    {
+        destroyRamdisk();
+        free(opts.mountpoint);
+        fuse_opt_free_args(&args);
+        return 1;
+    }
+
+    ret = 1;
+    se = fuse_session_new(&args, &ramdiskFuseOperations, sizeof(ramdiskFuseOperations), NULL);
+    if (se)
+    {
+        if (fuse_set_signal_handlers(se) == 0)
+        {
+            if (fuse_session_mount(se, opts.mountpoint) == 0)
+            {
+                fuse_daemonize(opts.foreground);
+                if (opts.singlethread)
+                {
+                    ret = fuse_session_loop(se);
+                }
+                else
+                {
+                    config.clone_fd = opts.clone_fd;
+                    config.max_idle_threads = opts.max_idle_threads;
+                    ret = fuse_session_loop_mt(se, &config);
+                }
+                fuse_session_unmount(se);
+            }
+            fuse_remove_signal_handlers(se);
+        }
+        fuse_session_destroy(se);
+    }
+
+    destroyRamdisk();
+    free(opts.mountpoint);
+    fuse_opt_free_args(&args);
+    return ret ? 1 : 0;
+}
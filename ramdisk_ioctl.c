@@ -5,6 +5,7 @@
 #include <fcntl.h>  // for open()
 #include <unistd.h> // for exit()
 #include <sys/ioctl.h> // for ioctl()
+#include <sys/mman.h>  // for mmap()
 
 int rd_creat(int deviceFd, char* pathname) {
     int returnValue;
@@ -106,6 +107,73 @@ int rd_lseek(int deviceFd, int fd, int offset) {
     return returnValue;
 }
 
+// Reads at offset; the descriptor's file position is left alone
+int rd_pread(int deviceFd, int fd, char* address, int num_bytes, int offset) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    // Populate params
+    params.address = address;
+    params.addressLength = num_bytes;
+    params.fd = fd;
+    params.num_bytes = num_bytes;
+    params.offset = offset;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_PREAD, &params);
+    return returnValue;
+}
+
+// Writes at offset; the descriptor's file position is left alone
+int rd_pwrite(int deviceFd, int fd, char* address, int num_bytes, int offset) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    // Populate params
+    params.address = address;
+    params.fd = fd;
+    params.num_bytes = num_bytes;
+    params.offset = offset;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_PWRITE, &params);
+    return returnValue;
+}
+
+// Reads into iovcnt buffers in order, as one read at the file position
+int rd_readv(int deviceFd, int fd, rd_iovec* iov, int iovcnt) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    // Populate params
+    params.fd = fd;
+    params.iov = iov;
+    params.iovcnt = iovcnt;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_READV, &params);
+    return returnValue;
+}
+
+// Writes iovcnt buffers in order, as one write at the file position
+int rd_writev(int deviceFd, int fd, rd_iovec* iov, int iovcnt) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    // Populate params
+    params.fd = fd;
+    params.iov = iov;
+    params.iovcnt = iovcnt;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_WRITEV, &params);
+    return returnValue;
+}
+
 int rd_unlink(int deviceFd, char* pathname) {
     int returnValue;
 
@@ -135,4 +203,232 @@ int rd_readdir(int deviceFd, int fd, char* address) {
     return returnValue;
 }
 
+// Reads the file at pathname without opening it. Copies at most num_bytes
+// and returns the file size, which may be larger than the copy
+int rd_readfile(int deviceFd, char* pathname, char* address, int num_bytes) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.pathname = pathname;
+    params.pathnameLength = strlen(pathname);
+    params.address = address;
+    params.addressLength = num_bytes;
+    params.num_bytes = num_bytes;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_READFILE, &params);
+    return returnValue;
+}
+
+// Creates or truncates the file at pathname and writes num_bytes to it
+int rd_writefile(int deviceFd, char* pathname, char* address, int num_bytes) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.pathname = pathname;
+    params.pathnameLength = strlen(pathname);
+    params.address = address;
+    params.num_bytes = num_bytes;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_WRITEFILE, &params);
+    return returnValue;
+}
+
+// Opens the file at pathname as an ordinary file descriptor that works with
+// read(), write(), lseek(), stdio and close()
+int rd_openfile(int deviceFd, char* pathname) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.pathname = pathname;
+    params.pathnameLength = strlen(pathname);
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_OPENFILE, &params);
+    return returnValue;
+}
+
+// Sends up to num_bytes from the file position of fd to outFd (a file,
+// pipe or socket) inside the kernel; returns the bytes sent
+int rd_sendfile(int deviceFd, int outFd, int fd, int num_bytes) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.fd = fd;
+    params.outFd = outFd;
+    params.num_bytes = num_bytes;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_SENDFILE, &params);
+    return returnValue;
+}
+
+// Maps the first num_bytes of an open file read-only; unmap with munmap()
+char* rd_mmap(int deviceFd, int fd, int num_bytes) {
+    char* address;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.fd = fd;
+
+    // Select the file, then map it through the device
+    if (ioctl(deviceFd, IOCTL_RD_MMAP, &params) < 0) {
+        return NULL;
+    }
+
+    address = mmap(NULL, num_bytes, PROT_READ, MAP_SHARED, deviceFd, 0);
+    if (address == MAP_FAILED) {
+        return NULL;
+    }
+    return address;
+}
+
+// Attaches a ring to this process and maps it; NULL on failure
+rd_ring* rd_ring_setup(int deviceFd) {
+    rd_ring* ring;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
 
+    if (ioctl(deviceFd, IOCTL_RD_RING_SETUP, &params) < 0) {
+        return NULL;
+    }
+
+    ring = mmap(NULL, sizeof(rd_ring), PROT_READ | PROT_WRITE, MAP_SHARED,
+                deviceFd, RD_RING_MMAP_OFFSET);
+    if (ring == MAP_FAILED) {
+        return NULL;
+    }
+    return ring;
+}
+
+// Returns the next free submission slot, or NULL if the ring is full
+rd_sqe* rd_ring_next_sqe(rd_ring* ring) {
+    unsigned int head = __atomic_load_n(&ring->sqHead, __ATOMIC_ACQUIRE);
+
+    if (ring->sqTail - head >= RD_RING_ENTRIES) {
+        return NULL;
+    }
+    return &ring->sqes[ring->sqTail & (RD_RING_ENTRIES - 1)];
+}
+
+// Prepares creat, mkdir, open or unlink
+void rd_prep_path(rd_sqe* sqe, unsigned int cmd, char* pathname) {
+    memset(&sqe->params, 0, sizeof(ioctl_rd));
+    sqe->cmd = cmd;
+    sqe->params.pathname = pathname;
+    sqe->params.pathnameLength = strlen(pathname);
+}
+
+// Prepares close
+void rd_prep_fd(rd_sqe* sqe, unsigned int cmd, int fd) {
+    memset(&sqe->params, 0, sizeof(ioctl_rd));
+    sqe->cmd = cmd;
+    sqe->params.fd = fd;
+}
+
+// Prepares read, write, pread, pwrite, lseek or readdir
+void rd_prep_rw(rd_sqe* sqe, unsigned int cmd, int fd, char* address, int num_bytes, int offset) {
+    memset(&sqe->params, 0, sizeof(ioctl_rd));
+    sqe->cmd = cmd;
+    sqe->params.fd = fd;
+    sqe->params.address = address;
+    sqe->params.addressLength = num_bytes;
+    sqe->params.num_bytes = num_bytes;
+    sqe->params.offset = offset;
+}
+
+// Makes the slot returned by rd_ring_next_sqe visible to the kernel
+void rd_ring_push(rd_ring* ring) {
+    __atomic_store_n(&ring->sqTail, ring->sqTail + 1, __ATOMIC_RELEASE);
+}
+
+// Runs up to toSubmit queued operations; returns how many ran
+int rd_ring_enter(int deviceFd, int toSubmit) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.num_bytes = toSubmit;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_RING_ENTER, &params);
+    return returnValue;
+}
+
+// Returns the oldest unseen completion, or NULL if there is none
+rd_cqe* rd_ring_peek_cqe(rd_ring* ring) {
+    unsigned int tail = __atomic_load_n(&ring->cqTail, __ATOMIC_ACQUIRE);
+
+    if (ring->cqHead == tail) {
+        return NULL;
+    }
+    return &ring->cqes[ring->cqHead & (RD_RING_ENTRIES - 1)];
+}
+
+// Releases the completion returned by rd_ring_peek_cqe
+void rd_ring_cqe_seen(rd_ring* ring) {
+    __atomic_store_n(&ring->cqHead, ring->cqHead + 1, __ATOMIC_RELEASE);
+}
+
+// Enables async requests for this process; eventFd may be -1
+int rd_aio_setup(int deviceFd, int eventFd) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.fd = eventFd;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_AIO_SETUP, &params);
+    return returnValue;
+}
+
+// Queues one request and returns its id without waiting for it
+int rd_aio_submit(int deviceFd, rd_sqe* sqe) {
+    int returnValue;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_AIO_SUBMIT, sqe);
+    return returnValue;
+}
+
+// Collects up to maxEntries finished requests; returns how many
+int rd_aio_reap(int deviceFd, rd_cqe* cqes, int maxEntries) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    params.address = (char*) cqes;
+    params.num_bytes = maxEntries;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_AIO_REAP, &params);
+    return returnValue;
+}
+
+// Makes the filesystem read-only until rd_thaw
+int rd_freeze(int deviceFd) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_FREEZE, &params);
+    return returnValue;
+}
+
+int rd_thaw(int deviceFd) {
+    int returnValue;
+
+    // Object holds the params we are passing
+    ioctl_rd params;
+
+    returnValue = ioctl(deviceFd, IOCTL_RD_THAW, &params);
+    return returnValue;
+}
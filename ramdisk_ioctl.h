@@ -20,6 +20,18 @@
 // Name of device
 #define DEVICE_NAME "ramdisk"
 
+// Longest pathname, including the terminating NUL
+#define RD_PATH_MAX 256
+
+// Most buffers a single vectored read or write may carry
+#define RD_IOV_MAX 16
+
+// One user buffer of a vectored read or write
+typedef struct {
+    char* address;
+    int num_bytes;
+} rd_iovec;
+
 // This is the structure we use to pass paremeters to the kernel
 typedef struct {
     char* pathname;
@@ -29,10 +41,68 @@ typedef struct {
     int addressLength;
     int num_bytes;
     int offset;
+    rd_iovec* iov;
+    int iovcnt;
+    int outFd;
     int ret;
 } ioctl_rd;
 
 
+// Submission/completion ring shared with the kernel through mmap. The client
+// fills sqes and advances sqTail; IOCTL_RD_RING_ENTER runs them in order and
+// posts one cqe each, advancing cqTail. Indexes wrap at RD_RING_ENTRIES.
+// Mapping the ring writable needs DEVICE_PATH opened O_RDWR, which the entry
+// allows every user.
+#define RD_RING_ENTRIES 256
+#define RD_RING_MMAP_OFFSET 0x40000000
+
+// One queued operation; cmd is one of the IOCTL_RD_* file commands
+typedef struct {
+    unsigned int cmd;
+    ioctl_rd params;
+    unsigned long long userData;
+} rd_sqe;
+
+// Result of one queued operation; id is its ring sequence number or the id
+// IOCTL_RD_AIO_SUBMIT returned
+typedef struct {
+    unsigned long long userData;
+    int ret;
+    int id;
+} rd_cqe;
+
+typedef struct {
+    unsigned int sqHead;    // advanced by the kernel
+    unsigned int sqTail;    // advanced by the client
+    unsigned int cqHead;    // advanced by the client
+    unsigned int cqTail;    // advanced by the kernel
+    rd_sqe sqes[RD_RING_ENTRIES];
+    rd_cqe cqes[RD_RING_ENTRIES];
+} rd_ring;
+
+
+// Reading /proc/ramdisk_backup streams an image of the filesystem, frozen
+// while the file is open: this header, the allocated inodes as they are in
+// kernel memory, the block bitmap, then the blocks it marks allocated in
+// block order. Block pointers keep their kernel values; a pointer p is
+// block (p - blockBase) / blockSize.
+#define RD_IMAGE_MAGIC "RDIMAGE"
+#define RD_IMAGE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    int version;
+    int blockSize;
+    int blockCount;
+    int inodeCount;
+    int inodeSize;
+    int bitmapSize;
+    unsigned int freeBlocks;
+    unsigned int freeInodes;
+    int imageInodes;        // inode records that follow
+    int imageBlocks;        // blocks that follow the bitmap
+    unsigned long long blockBase;
+} rd_image_header;
 // messages to the kernel
 // _IOR = passing information from user process to kernel module
 // _IOW = passing information from kernel module to user process
@@ -46,6 +116,22 @@ typedef struct {
 #define IOCTL_RD_LSEEK    _IOWR(MAJOR_NUM, 6, ioctl_rd)
 #define IOCTL_RD_UNLINK   _IOWR(MAJOR_NUM, 7, ioctl_rd)
 #define IOCTL_RD_READDIR  _IOWR(MAJOR_NUM, 8, ioctl_rd)
+#define IOCTL_RD_MMAP     _IOWR(MAJOR_NUM, 9, ioctl_rd)
+#define IOCTL_RD_PREAD    _IOWR(MAJOR_NUM, 10, ioctl_rd)
+#define IOCTL_RD_PWRITE   _IOWR(MAJOR_NUM, 11, ioctl_rd)
+#define IOCTL_RD_READV    _IOWR(MAJOR_NUM, 12, ioctl_rd)
+#define IOCTL_RD_WRITEV   _IOWR(MAJOR_NUM, 13, ioctl_rd)
+#define IOCTL_RD_RING_SETUP _IOWR(MAJOR_NUM, 14, ioctl_rd)
+#define IOCTL_RD_RING_ENTER _IOWR(MAJOR_NUM, 15, ioctl_rd)
+#define IOCTL_RD_READFILE _IOWR(MAJOR_NUM, 16, ioctl_rd)
+#define IOCTL_RD_WRITEFILE _IOWR(MAJOR_NUM, 17, ioctl_rd)
+#define IOCTL_RD_OPENFILE _IOWR(MAJOR_NUM, 18, ioctl_rd)
+#define IOCTL_RD_SENDFILE _IOWR(MAJOR_NUM, 19, ioctl_rd)
+#define IOCTL_RD_AIO_SETUP  _IOWR(MAJOR_NUM, 20, ioctl_rd)
+#define IOCTL_RD_AIO_SUBMIT _IOWR(MAJOR_NUM, 21, rd_sqe)
+#define IOCTL_RD_AIO_REAP   _IOWR(MAJOR_NUM, 22, ioctl_rd)
+#define IOCTL_RD_FREEZE   _IOWR(MAJOR_NUM, 23, ioctl_rd)
+#define IOCTL_RD_THAW     _IOWR(MAJOR_NUM, 24, ioctl_rd)
 
 // Wrapper functions
 int rd_creat(int deviceFd, char* pathname);
@@ -55,8 +141,45 @@ int rd_close(int deviceFd, int fd);
 int rd_read(int deviceFd, int fd, char* address, int num_bytes);
 int rd_write(int deviceFd, int fd, char* address, int num_bytes);
 int rd_lseek(int deviceFd, int fd, int offset);
+int rd_pread(int deviceFd, int fd, char* address, int num_bytes, int offset);
+int rd_pwrite(int deviceFd, int fd, char* address, int num_bytes, int offset);
+int rd_readv(int deviceFd, int fd, rd_iovec* iov, int iovcnt);
+int rd_writev(int deviceFd, int fd, rd_iovec* iov, int iovcnt);
 int rd_unlink(int deviceFd, char* pathname);
 int rd_readdir(int deviceFd, int fd, char* address);
+char* rd_mmap(int deviceFd, int fd, int num_bytes);
+// rd_writefile replaces the whole file, creating it if needed; descriptors
+// opened on the old contents fail afterwards as after an unlink, and a file
+// that is mapped or open through rd_openfile is not replaced
+int rd_readfile(int deviceFd, char* pathname, char* address, int num_bytes);
+int rd_writefile(int deviceFd, char* pathname, char* address, int num_bytes);
+int rd_openfile(int deviceFd, char* pathname);
+int rd_sendfile(int deviceFd, int outFd, int fd, int num_bytes);
+
+// Freezing makes the filesystem read-only: creat, mkdir, write and unlink
+// fail until it is thawed, and reads take no locks meanwhile. Reading
+// /proc/ramdisk_backup keeps it frozen as well, and rd_thaw fails while an
+// image is open
+int rd_freeze(int deviceFd);
+int rd_thaw(int deviceFd);
+
+// Ring helpers: take an sqe with rd_ring_next_sqe, fill it with an rd_prep_*
+// call, queue it with rd_ring_push, then run the batch with rd_ring_enter
+rd_ring* rd_ring_setup(int deviceFd);
+rd_sqe* rd_ring_next_sqe(rd_ring* ring);
+void rd_prep_path(rd_sqe* sqe, unsigned int cmd, char* pathname);
+void rd_prep_fd(rd_sqe* sqe, unsigned int cmd, int fd);
+void rd_prep_rw(rd_sqe* sqe, unsigned int cmd, int fd, char* address, int num_bytes, int offset);
+void rd_ring_push(rd_ring* ring);
+int rd_ring_enter(int deviceFd, int toSubmit);
+rd_cqe* rd_ring_peek_cqe(rd_ring* ring);
+void rd_ring_cqe_seen(rd_ring* ring);
+
+// Async helpers: pread, pwrite and unlink sqes (filled with rd_prep_*) run on
+// kernel workers; each completion signals the eventfd given to rd_aio_setup
+int rd_aio_setup(int deviceFd, int eventFd);
+int rd_aio_submit(int deviceFd, rd_sqe* sqe);
+int rd_aio_reap(int deviceFd, rd_cqe* cqes, int maxEntries);
 
 
 #endif
@@ -0,0 +1,1961 @@
+/*
+ * ramdisk_kmod.c - the kernel module around the filesystem core: the
+ * /proc entries, ioctl dispatch, mmap, opened files, sendfile and async I/O
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/utsname.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+#include <linux/ioctl.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/file.h>
+#include <linux/anon_inodes.h>
+#include <linux/rwsem.h>
+#include <linux/seqlock.h>
+#include <linux/rcupdate.h>
+#include <linux/uio.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/eventfd.h>
+#include <linux/mmu_context.h>
+#include <linux/kthread.h>
+#include <linux/compat.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/bitops.h>
+#include <linux/uaccess.h>
+#include <asm/string.h>
+#include <asm/unistd.h>
+
+#include "ramdisk.h"
+#include "ramdisk_ioctl.h"
+
+//the tracepoints are defined here, see ramdisk_trace.h
+#define CREATE_TRACE_POINTS
+#include "ramdisk_trace.h"
+
+
+//kernel interfaces that changed under the module since 2.6; those the
+//core uses as well are in ramdisk_platform.h
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+#define RD_HAVE_PROC_OPS                  //proc entries take a struct proc_ops
+typedef struct proc_ops rdProcOperations;
+#else
+typedef struct file_operations rdProcOperations;
+#endif
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 17, 0)
+#define ktime_get_ns() ktime_to_ns(ktime_get())
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 1, 0)
+#define RD_HAVE_RW_ITER                   //read_iter/write_iter with IOCB_APPEND
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#define RD_FAULT_HAS_VMA                  //fault(vmf) finds the vma in vmf->vma
+#endif
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 17, 0)
+typedef int vm_fault_t;
+#endif
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+static inline void vm_flags_set(struct vm_area_struct* vma, unsigned long flags) 
+{
+    vma->vm_flags |= flags;
+}
+
+static inline void vm_flags_clear(struct vm_area_struct* vma, unsigned long flags) 
+{
+    vma->vm_flags &= ~flags;
+}
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+#define use_mm kthread_use_mm
+#define unuse_mm kthread_unuse_mm
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+#define rdEventfdSignal(ctx) eventfd_signal(ctx)
+#else
+#define rdEventfdSignal(ctx) eventfd_signal(ctx, 1)
+#endif
+
+//set_fs is gone from 5.10, kernel buffers are written through a kvec iterator
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+typedef struct kvec rdKernelVec;
+#else
+typedef struct iovec rdKernelVec;
+#endif
+
+
+
+static rdProcOperations ramdiskOperations;                //device entry points
+static rdProcOperations ramdiskBackupOperations;          //backup entry points
+static rdProcOperations ramdiskStatsOperations;           //statistics entry points
+static struct vm_operations_struct ramdiskVmOperations;   //mapped file operation
+static struct file_operations ramdiskFileOperations;      //opened file operation
+static struct proc_dir_entry *proc_entry;                 //proc entry
+static struct workqueue_struct* aioWorkqueue;             //async request workers
+static struct proc_dir_entry *proc_backup;               
+static struct proc_dir_entry *proc_stats;                 //statistics entry
+static struct proc_dir_entry *proc_latency;               //latency histogram entry
+static rdProcOperations ramdiskLatencyOperations;         //latency histogram entry points
+static struct proc_dir_entry *proc_space;                 //space report entry
+static rdProcOperations ramdiskSpaceOperations;           //space report entry points
+
+//a mapping outlives the file it was made through, and proc entries have no
+//owner to pin the module, so every vma holds a module reference of its own
+static void ramdisk_vma_open(struct vm_area_struct* vma) 
+{
+    inode* inodePointer = (inode*) vma->vm_private_data;
+    __module_get(THIS_MODULE);
+    lockInode(inodePointer->inodeNumber, TRUE);
+    inodePointer->mapCount++;
+    unlockInode(inodePointer->inodeNumber, TRUE);
+}
+
+static void ramdisk_vma_close(struct vm_area_struct* vma) 
+{
+    inode* inodePointer = (inode*) vma->vm_private_data;
+    lockInode(inodePointer->inodeNumber, TRUE);
+    inodePointer->mapCount--;
+    unlockInode(inodePointer->inodeNumber, TRUE);
+    module_put(THIS_MODULE);
+}
+
+//resolves a page of a mapped file to the block group backing it
+#ifdef RD_FAULT_HAS_VMA
+static vm_fault_t ramdisk_vma_fault(struct vm_fault* vmf) 
+{
+    struct vm_area_struct* vma = vmf->vma;
+#else
+static vm_fault_t ramdisk_vma_fault(struct vm_area_struct* vma, struct vm_fault* vmf) 
+{
+#endif
+    inode* inodePointer;
+    char* pageAddress;
+    int filePosition;
+
+    inodePointer = (inode*) vma->vm_private_data;
+
+    if (vmf->pgoff > (MAX_FILE_SIZE >> PAGE_SHIFT)) 
+    {
+        return VM_FAULT_SIGBUS;
+    }
+
+    filePosition = vmf->pgoff << PAGE_SHIFT;
+    lockInode(inodePointer->inodeNumber, FALSE);
+    if (filePosition >= inodePointer->size) 
+    {
+        unlockInode(inodePointer->inodeNumber, FALSE);
+        return VM_FAULT_SIGBUS;
+    }
+
+    pageAddress = NULL;
+    mapFilepositionToMemAddr(inodePointer, filePosition, &pageAddress);
+    if (pageAddress == NULL) 
+    {
+        unlockInode(inodePointer->inodeNumber, FALSE);
+        return VM_FAULT_SIGBUS;
+    }
+
+    vmf->page = vmalloc_to_page(pageAddress);
+    get_page(vmf->page);
+    unlockInode(inodePointer->inodeNumber, FALSE);
+    return 0;
+}
+
+//maps the process's ring, or the file selected with IOCTL_RD_MMAP; shared
+//file mappings are read-only, and private ones copy each page they write,
+//so the file and its size only change through writes
+static int ramdisk_mmap(struct file* file, struct vm_area_struct* vma) 
+{
+    fileDescriptorNode* fdMap;
+
+    fdMap = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+
+    if (vma->vm_pgoff == (RD_RING_MMAP_OFFSET >> PAGE_SHIFT)) 
+    {
+        if (fdMap == NULL || fdMap->ring == NULL) 
+        {
+            return -EINVAL;
+        }
+        return remap_vmalloc_range(vma, fdMap->ring, 0);
+    }
+
+    //the selection pins the file, see ram_mmap
+    if (fdMap == NULL || fdMap->mmapInode == NULL || !(fdMap->mmapInode->flags & INODE_FLAG_MAPPABLE)) 
+    {
+        return -EINVAL;
+    }
+
+    if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_WRITE)) 
+    {
+        return -EACCES;
+    }
+
+    vm_flags_clear(vma, VM_MAYWRITE);
+    vm_flags_set(vma, VM_DONTEXPAND);
+    vma->vm_ops = &ramdiskVmOperations;
+    vma->vm_private_data = fdMap->mmapInode;
+    ramdisk_vma_open(vma);
+
+    return 0;
+}
+
+
+//copies the user's pathname into a path buffer; NULL if it is missing,
+//not absolute or does not fit in RD_PATH_MAX
+static char* copyPathFromUser(ioctl_rd* params) 
+{
+    char* path;
+    long length;
+
+    path = allocPath();
+    if (!path) 
+    {
+        return NULL;
+    }
+
+    length = strncpy_from_user(path, params->pathname, RD_PATH_MAX);
+    if (length <= 0 || length >= RD_PATH_MAX || path[0] != '/') 
+    {
+        freePath(path);
+        return NULL;
+    }
+    return path;
+}
+
+//bounce buffer for data; small transfers come from the slab allocator
+static char* allocBuffer(int size) 
+{
+    if (size < 0 || size > MAX_FILE_SIZE) 
+    {
+        return NULL;
+    }
+
+    if (size <= PAGE_SIZE) 
+    {
+        return (char*) kmalloc(size, GFP_KERNEL);
+    }
+    return (char*) vmalloc(size);
+}
+
+static void freeBuffer(char* buffer, int size) 
+{
+    if (size <= PAGE_SIZE) 
+    {
+        kfree(buffer);
+    }
+    else 
+    {
+        vfree(buffer);
+    }
+}
+
+//vectored read or write: the user buffers are gathered into (or scattered
+//from) one kernel buffer so the file is accessed by a single call
+static int ramdisk_iov(unsigned int cmd, ioctl_rd* params) 
+{
+    rd_iovec iov[RD_IOV_MAX];
+    char* kernelAddress;
+    char* iter;
+    int total, remaining, i, ret;
+
+    if (params->iovcnt <= 0 || params->iovcnt > RD_IOV_MAX) 
+    {
+        return -1;
+    }
+
+    if (copy_from_user(iov, params->iov, sizeof(rd_iovec) * params->iovcnt)) 
+    {
+        return -EFAULT;
+    }
+
+    total = 0;
+    for (i = 0; i < params->iovcnt; i++) 
+    {
+        if (iov[i].num_bytes < 0 || iov[i].num_bytes > MAX_FILE_SIZE - total) 
+        {
+            return -1;
+        }
+        total += iov[i].num_bytes;
+    }
+
+    kernelAddress = allocBuffer(total);
+    if (!kernelAddress) 
+    {
+        return -1;
+    }
+
+    if (cmd == IOCTL_RD_WRITEV) 
+    {
+        iter = kernelAddress;
+        for (i = 0; i < params->iovcnt; i++) 
+        {
+            //a faulting buffer would leave the rest of the kernel buffer
+            //uninitialized in the file
+            if (copy_from_user(iter, iov[i].address, iov[i].num_bytes)) 
+            {
+                freeBuffer(kernelAddress, total);
+                return -EFAULT;
+            }
+            iter += iov[i].num_bytes;
+        }
+        ret = ram_write(params->fd, kernelAddress, total);
+    }
+    else 
+    {
+        ret = ram_read(params->fd, kernelAddress, total);
+
+        iter = kernelAddress;
+        remaining = ret;
+        for (i = 0; i < params->iovcnt && remaining > 0; i++) 
+        {
+            if (copy_to_user(iov[i].address, iter, getMin(iov[i].num_bytes, remaining))) 
+            {
+                ret = -EFAULT;
+                break;
+            }
+            iter += iov[i].num_bytes;
+            remaining -= iov[i].num_bytes;
+        }
+    }
+
+    freeBuffer(kernelAddress, total);
+    return ret;
+}
+
+//runs one ramdisk command; shared by the ioctl entry and the ring
+static int ramdisk_dispatch(unsigned int cmd, ioctl_rd* params) 
+{
+    char* path;
+    char* kernelAddress;
+    char entry[DIR_ENTRY_STRUCTURE_SIZE];
+    int ret;
+
+    switch (cmd) 
+    {
+        case IOCTL_RD_CREAT://create 
+        case IOCTL_RD_MKDIR://mkdir
+        case IOCTL_RD_OPEN://open
+        case IOCTL_RD_UNLINK://unlink
+            path = copyPathFromUser(params);
+            if (!path) 
+            {
+                return -1;
+            }
+
+            if (cmd == IOCTL_RD_CREAT) 
+            {
+                ret = ram_creat(path);
+            }
+            else if (cmd == IOCTL_RD_MKDIR) 
+            {
+                ret = ram_mkdir(path);
+            }
+            else if (cmd == IOCTL_RD_OPEN) 
+            {
+                ret = ram_open(path);
+            }
+            else 
+            {
+                ret = ram_unlink(path);
+            }
+            freePath(path);
+            return ret;
+            break;
+        
+        case IOCTL_RD_CLOSE://close
+            ret = ram_close(params->fd);
+            return ret;
+            break;
+
+        case IOCTL_RD_READ://read
+        case IOCTL_RD_PREAD://positional read
+            kernelAddress = allocBuffer(params->num_bytes);
+            if (!kernelAddress) 
+            {
+                return -1;
+            }
+
+            if (cmd == IOCTL_RD_READ) 
+            {
+                ret = ram_read(params->fd, kernelAddress, params->num_bytes);
+            }
+            else 
+            {
+                ret = ram_pread(params->fd, kernelAddress, params->num_bytes, params->offset);
+            }
+            if (ret > 0 && copy_to_user(params->address, kernelAddress, ret)) 
+            {
+                ret = -EFAULT;
+            }
+            freeBuffer(kernelAddress, params->num_bytes);
+            return ret;
+            break;
+    
+        case IOCTL_RD_WRITE://write
+        case IOCTL_RD_PWRITE://positional write
+            kernelAddress = allocBuffer(params->num_bytes);
+            if (!kernelAddress) 
+            {
+                return -1;
+            }
+
+            //never write a partially filled kernel buffer
+            if (copy_from_user(kernelAddress, params->address, (unsigned long) params->num_bytes)) 
+            {
+                freeBuffer(kernelAddress, params->num_bytes);
+                return -EFAULT;
+            }
+            if (cmd == IOCTL_RD_WRITE) 
+            {
+                ret = ram_write(params->fd, kernelAddress, params->num_bytes);
+            }
+            else 
+            {
+                ret = ram_pwrite(params->fd, kernelAddress, params->num_bytes, params->offset);
+            }
+            freeBuffer(kernelAddress, params->num_bytes);
+            return ret;
+            break;
+    
+        case IOCTL_RD_READV://vectored read
+        case IOCTL_RD_WRITEV://vectored write
+            ret = ramdisk_iov(cmd, params);
+            return ret;
+            break;
+
+        case IOCTL_RD_LSEEK://lseek
+            ret = ram_lseek(params->fd, params->offset);
+            return ret;
+            break;
+
+        case IOCTL_RD_READDIR://readdir
+            memset(entry, 0, DIR_ENTRY_STRUCTURE_SIZE);
+            ret = ram_readdir(params->fd, entry);
+            if (copy_to_user(params->address, entry, DIR_ENTRY_STRUCTURE_SIZE)) 
+            {
+                return -EFAULT;
+            }
+            return ret;
+            break;
+
+        case IOCTL_RD_READFILE://read a whole file by path
+        case IOCTL_RD_WRITEFILE://replace a whole file by path
+            path = copyPathFromUser(params);
+            if (!path) 
+            {
+                return -1;
+            }
+
+            kernelAddress = allocBuffer(params->num_bytes);
+            if (!kernelAddress) 
+            {
+                freePath(path);
+                return -1;
+            }
+
+            if (cmd == IOCTL_RD_READFILE) 
+            {
+                ret = ram_readfile(path, kernelAddress, params->num_bytes);
+                if (ret > 0 && copy_to_user(params->address, kernelAddress, getMin(ret, params->num_bytes))) 
+                {
+                    ret = -EFAULT;
+                }
+            }
+            else if (copy_from_user(kernelAddress, params->address, (unsigned long) params->num_bytes)) 
+            {
+                ret = -EFAULT;
+            }
+            else 
+            {
+                ret = ram_writefile(path, kernelAddress, params->num_bytes);
+            }
+            freeBuffer(kernelAddress, params->num_bytes);
+            freePath(path);
+            return ret;
+            break;
+
+        case IOCTL_RD_MMAP://select file for mmap
+            ret = ram_mmap(params->fd);
+            return ret;
+            break;
+
+        case IOCTL_RD_SENDFILE://copy to another file in the kernel
+            ret = ramdisk_sendfile(params);
+            return ret;
+            break;
+
+        case IOCTL_RD_OPENFILE://open as a real file
+            ret = ramdisk_openfile(params);
+            return ret;
+            break;
+
+        case IOCTL_RD_FREEZE://make read-only
+            ret = ram_freeze();
+            return ret;
+            break;
+
+        case IOCTL_RD_THAW://make writable again
+            ret = ram_thaw();
+            return ret;
+            break;
+
+        default:
+            return -EINVAL;
+            break;
+    }
+    return 0;
+}
+
+//attaches a submission/completion ring to the calling process; the client
+//maps it with mmap at RD_RING_MMAP_OFFSET
+static int ramdisk_ring_setup(void) 
+{
+    fileDescriptorNode* node;
+
+    node = getFileDescriptorNode(rdCurrentPid());
+    if (node == NULL) 
+    {
+        return -1;
+    }
+
+    if (node->ring == NULL) 
+    {
+        node->ring = (rd_ring*) vmalloc_user(sizeof(rd_ring));
+        if (node->ring == NULL) 
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+//drains up to toSubmit queued operations in order, posting one completion
+//each; stops early when the completion ring is full
+static int ramdisk_ring_enter(int toSubmit) 
+{
+    fileDescriptorNode* node;
+    rd_ring* ring;
+    rd_sqe sqe;
+    rd_cqe* cqe;
+    unsigned int head, tail;
+    int done;
+
+    node = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (node == NULL || node->ring == NULL) 
+    {
+        return -1;
+    }
+
+    ring = node->ring;
+    head = ring->sqHead;
+    tail = ACCESS_ONCE(ring->sqTail);
+    smp_rmb();
+
+    for (done = 0; head != tail && done < toSubmit; done++) 
+    {
+        if (ring->cqTail - ACCESS_ONCE(ring->cqHead) >= RD_RING_ENTRIES) 
+        {
+            break;
+        }
+
+        //the entry stays in user memory, take a stable copy first
+        memcpy(&sqe, &ring->sqes[head & (RD_RING_ENTRIES - 1)], sizeof(rd_sqe));
+
+        cqe = &ring->cqes[ring->cqTail & (RD_RING_ENTRIES - 1)];
+        cqe->userData = sqe.userData;
+        cqe->id = head;
+        cqe->ret = ramdisk_dispatch(sqe.cmd, &sqe.params);
+
+        smp_wmb();
+        ring->cqTail++;
+        head++;
+        ring->sqHead = head;
+    }
+
+    return done;
+}
+
+//file operations of files opened with IOCTL_RD_OPENFILE: private_data is
+//the inode and the position is the file's own f_pos; user memory is only
+//touched outside the inode lock
+//reads up to count bytes at position of an opened file into kernelAddress
+static int ramdisk_file_read_at(inode* inodePointer, char* kernelAddress, size_t count, loff_t position) 
+{
+    int ret;
+    int fileSize;
+
+    rdStatInc(RD_STAT_READ);
+    ret = readFrozenInode(inodePointer, position, kernelAddress, count);
+    if (ret == -2) 
+    {
+        ret = readSmallInode(inodePointer, position, kernelAddress, count, &fileSize);
+    }
+    if (ret == -2) 
+    {
+        lockInode(inodePointer->inodeNumber, FALSE);
+        ret = readFromInode(inodePointer, position, kernelAddress, count);
+        unlockInode(inodePointer->inodeNumber, FALSE);
+    }
+    rdStatAdd(RD_STAT_BYTES_READ, ret);
+    return ret;
+}
+
+//writes count bytes from kernelAddress at *ppos, or at the end of the file
+//if append is set, and moves *ppos past them
+static int ramdisk_file_write_at(inode* inodePointer, char* kernelAddress, size_t count, loff_t* ppos, int append) 
+{
+    int ret;
+
+    rdStatInc(RD_STAT_WRITE);
+    if (beginMutation() == -1) 
+    {
+        return -EROFS;
+    }
+    lockInode(inodePointer->inodeNumber, TRUE);
+    if (append) 
+    {
+        *ppos = inodePointer->size;
+    }
+
+    //files have no holes
+    if (*ppos > inodePointer->size) 
+    {
+        ret = -EINVAL;
+    }
+    else 
+    {
+        ret = writeToInode(inodePointer, *ppos, kernelAddress, count);
+        if (ret < 0) 
+        {
+            ret = -ENOSPC;
+        }
+        else 
+        {
+            *ppos += ret;
+            rdStatAdd(RD_STAT_BYTES_WRITTEN, ret);
+        }
+    }
+    unlockInode(inodePointer->inodeNumber, TRUE);
+    endMutation();
+    return ret;
+}
+
+#ifdef RD_HAVE_RW_ITER
+static ssize_t ramdisk_file_read_iter(struct kiocb* iocb, struct iov_iter* to) 
+{
+    inode* inodePointer;
+    char* kernelAddress;
+    size_t count;
+    int ret;
+
+    inodePointer = (inode*) iocb->ki_filp->private_data;
+    if (iocb->ki_pos >= MAX_FILE_SIZE) 
+    {
+        return 0;
+    }
+    count = min_t(size_t, iov_iter_count(to), MAX_FILE_SIZE);
+
+    kernelAddress = allocBuffer(count);
+    if (!kernelAddress) 
+    {
+        return -ENOMEM;
+    }
+
+    ret = ramdisk_file_read_at(inodePointer, kernelAddress, count, iocb->ki_pos);
+    if (ret > 0) 
+    {
+        if (copy_to_iter(kernelAddress, ret, to) != ret) 
+        {
+            ret = -EFAULT;
+        }
+        else 
+        {
+            iocb->ki_pos += ret;
+        }
+    }
+
+    freeBuffer(kernelAddress, count);
+    return ret;
+}
+
+static ssize_t ramdisk_file_write_iter(struct kiocb* iocb, struct iov_iter* from) 
+{
+    inode* inodePointer;
+    char* kernelAddress;
+    size_t count;
+    int ret;
+
+    inodePointer = (inode*) iocb->ki_filp->private_data;
+    count = iov_iter_count(from);
+    if (count > MAX_FILE_SIZE) 
+    {
+        return -EFBIG;
+    }
+
+    kernelAddress = allocBuffer(count);
+    if (!kernelAddress) 
+    {
+        return -ENOMEM;
+    }
+    if (copy_from_iter(kernelAddress, count, from) != count) 
+    {
+        freeBuffer(kernelAddress, count);
+        return -EFAULT;
+    }
+
+    ret = ramdisk_file_write_at(inodePointer, kernelAddress, count, &iocb->ki_pos, iocb->ki_flags & IOCB_APPEND);
+
+    freeBuffer(kernelAddress, count);
+    return ret;
+}
+#else
+static ssize_t ramdisk_file_read(struct file* file, char __user* buf, size_t count, loff_t* ppos) 
+{
+    inode* inodePointer;
+    char* kernelAddress;
+    int ret;
+
+    inodePointer = (inode*) file->private_data;
+    if (*ppos >= MAX_FILE_SIZE) 
+    {
+        return 0;
+    }
+    count = min_t(size_t, count, MAX_FILE_SIZE);
+
+    kernelAddress = allocBuffer(count);
+    if (!kernelAddress) 
+    {
+        return -ENOMEM;
+    }
+
+    ret = ramdisk_file_read_at(inodePointer, kernelAddress, count, *ppos);
+    if (ret > 0) 
+    {
+        if (copy_to_user(buf, kernelAddress, ret)) 
+        {
+            ret = -EFAULT;
+        }
+        else 
+        {
+            *ppos += ret;
+        }
+    }
+
+    freeBuffer(kernelAddress, count);
+    return ret;
+}
+
+static ssize_t ramdisk_file_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) 
+{
+    inode* inodePointer;
+    char* kernelAddress;
+    int ret;
+
+    inodePointer = (inode*) file->private_data;
+    if (count > MAX_FILE_SIZE) 
+    {
+        return -EFBIG;
+    }
+
+    kernelAddress = allocBuffer(count);
+    if (!kernelAddress) 
+    {
+        return -ENOMEM;
+    }
+    if (copy_from_user(kernelAddress, buf, count)) 
+    {
+        freeBuffer(kernelAddress, count);
+        return -EFAULT;
+    }
+
+    ret = ramdisk_file_write_at(inodePointer, kernelAddress, count, ppos, file->f_flags & O_APPEND);
+
+    freeBuffer(kernelAddress, count);
+    return ret;
+}
+#endif
+
+static loff_t ramdisk_file_llseek(struct file* file, loff_t offset, int whence) 
+{
+    inode* inodePointer;
+    loff_t position;
+
+    inodePointer = (inode*) file->private_data;
+
+    lockInode(inodePointer->inodeNumber, FALSE);
+    switch (whence) 
+    {
+        case SEEK_SET:
+            position = offset;
+            break;
+        case SEEK_CUR:
+            position = file->f_pos + offset;
+            break;
+        case SEEK_END:
+            position = inodePointer->size + offset;
+            break;
+        default:
+            position = -1;
+            break;
+    }
+
+    if (position < 0 || position > inodePointer->size) 
+    {
+        unlockInode(inodePointer->inodeNumber, FALSE);
+        return -EINVAL;
+    }
+
+    file->f_pos = position;
+    unlockInode(inodePointer->inodeNumber, FALSE);
+    return position;
+}
+
+static int ramdisk_file_release(struct inode* vfsInode, struct file* file) 
+{
+    inode* inodePointer;
+
+    inodePointer = (inode*) file->private_data;
+
+    lockInode(inodePointer->inodeNumber, TRUE);
+    inodePointer->openCount--;
+    unlockInode(inodePointer->inodeNumber, TRUE);
+    return 0;
+}
+
+//writes the kernel buffers in vec, length bytes in all, to file at position
+static ssize_t writeKernelVec(struct file* file, rdKernelVec* vec, int segments, size_t length, loff_t* position) 
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+    struct iov_iter iter;
+
+    iov_iter_kvec(&iter, WRITE, vec, segments, length);
+    return vfs_iter_write(file, &iter, position, 0);
+#else
+    mm_segment_t oldFs;
+    ssize_t ret;
+
+    oldFs = get_fs();
+    set_fs(KERNEL_DS);
+    ret = vfs_writev(file, (struct iovec __user*) vec, segments, position);
+    set_fs(oldFs);
+    return ret;
+#endif
+}
+
+//sends up to num_bytes from the descriptor position to another open file
+//or socket; RD_SENDFILE_CHUNK bytes at a time are copied out under the
+//inode read lock, which is dropped before the write so a slow socket never
+//holds up writers of the ramdisk file
+static int ramdisk_sendfile(ioctl_rd* params) 
+{
+    fileDescriptorNode* fdSend;
+    inode* inodePointer;
+    struct file* outFile;
+    rdKernelVec vec;
+    char* kernelAddress;
+    loff_t outPosition;
+    int position, requested, queued;
+    int written, totalBytesSent;
+
+    if (params->fd < 0 || params->fd >= MAX_FILES_OPEN || params->num_bytes < 0) 
+    {
+        return -1;
+    }
+
+    fdSend = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (fdSend == NULL || fdSend->fileDescriptorTable[params->fd].inodePointer == NULL) 
+    {
+        return -1;
+    }
+
+    outFile = fget(params->outFd);
+    if (!outFile) 
+    {
+        return -EBADF;
+    }
+    if (!(outFile->f_mode & FMODE_WRITE)) 
+    {
+        fput(outFile);
+        return -EBADF;
+    }
+    kernelAddress = allocBuffer(RD_SENDFILE_CHUNK);
+    if (!kernelAddress) 
+    {
+        fput(outFile);
+        return -ENOMEM;
+    }
+
+    inodePointer = fdSend->fileDescriptorTable[params->fd].inodePointer;
+    position = fdSend->fileDescriptorTable[params->fd].filePosition;
+    requested = params->num_bytes;
+    totalBytesSent = 0;
+    written = 0;
+
+    //the output position is owned for the whole call, as write(2) does
+    if (outFile->f_mode & FMODE_ATOMIC_POS) 
+    {
+        mutex_lock(&outFile->f_pos_lock);
+    }
+    outPosition = outFile->f_pos;
+
+    while (requested > 0) 
+    {
+        lockInode(inodePointer->inodeNumber, FALSE);
+        if (isStaleDescriptor(&fdSend->fileDescriptorTable[params->fd])) 
+        {
+            unlockInode(inodePointer->inodeNumber, FALSE);
+            written = -1;
+            break;
+        }
+        queued = readFromInode(inodePointer, position, kernelAddress, getMin(requested, RD_SENDFILE_CHUNK));
+        unlockInode(inodePointer->inodeNumber, FALSE);
+        if (queued <= 0) 
+        {
+            break;
+        }
+
+        vec.iov_base = kernelAddress;
+        vec.iov_len = queued;
+        written = writeKernelVec(outFile, &vec, 1, queued, &outPosition);
+        if (written <= 0) 
+        {
+            break;
+        }
+
+        position += written;
+        requested -= written;
+        totalBytesSent += written;
+        if (written < queued) 
+        {
+            break;
+        }
+    }
+
+    outFile->f_pos = outPosition;
+    if (outFile->f_mode & FMODE_ATOMIC_POS) 
+    {
+        mutex_unlock(&outFile->f_pos_lock);
+    }
+
+    freeBuffer(kernelAddress, RD_SENDFILE_CHUNK);
+    fput(outFile);
+
+    fdSend->fileDescriptorTable[params->fd].filePosition = position;
+
+    if (totalBytesSent == 0 && written < 0) 
+    {
+        return written;
+    }
+    return totalBytesSent;
+}
+
+//gives the file at the user's pathname a struct file of its own
+static int ramdisk_openfile(ioctl_rd* params) 
+{
+    char* path;
+    int fileInodeNum;
+    int ret;
+
+    path = copyPathFromUser(params);
+    if (!path) 
+    {
+        return -1;
+    }
+
+    fileInodeNum = ram_openfile(path);
+    freePath(path);
+    if (fileInodeNum == -1) 
+    {
+        return -1;
+    }
+
+    ret = anon_inode_getfd("[ramdisk]", &ramdiskFileOperations, &inodeArray[fileInodeNum], O_RDWR);
+    if (ret < 0) 
+    {
+        lockInode(fileInodeNum, TRUE);
+        inodeArray[fileInodeNum].openCount--;
+        unlockInode(fileInodeNum, TRUE);
+    }
+    return ret;
+}
+
+// Asynchronous requests: one per submitted sqe, run by aioWorkqueue in the
+// submitter's address space and parked on its context until reaped
+struct rdAioContext_t {
+    struct eventfd_ctx* eventfd;    // signalled once per completion, may be NULL
+    spinlock_t lock;                // protects completed
+    struct list_head completed;
+    int nextId;
+};
+
+typedef struct {
+    struct work_struct work;
+    struct list_head list;
+    rd_sqe sqe;
+    inode* inodePointer;            // pinned by openCount while queued
+    char* path;
+    struct mm_struct* mm;
+    rdAioContext* context;
+    struct eventfd_ctx* eventfd;    // referenced at submit, may be NULL
+    int id;
+    int ret;
+} rdAioRequest;
+
+//sets up (or replaces the eventfd of) the async context of the caller;
+//eventFd may be -1 to harvest without notification
+static int ramdisk_aio_setup(int eventFd) 
+{
+    fileDescriptorNode* node;
+    struct eventfd_ctx* eventfd;
+
+    node = getFileDescriptorNode(rdCurrentPid());
+    if (node == NULL) 
+    {
+        return -1;
+    }
+
+    eventfd = NULL;
+    if (eventFd >= 0) 
+    {
+        eventfd = eventfd_ctx_fdget(eventFd);
+        if (IS_ERR(eventfd)) 
+        {
+            return PTR_ERR(eventfd);
+        }
+    }
+
+    if (node->aio == NULL) 
+    {
+        node->aio = (rdAioContext*) kzalloc(sizeof(rdAioContext), GFP_KERNEL);
+        if (node->aio == NULL) 
+        {
+            if (eventfd) 
+            {
+                eventfd_ctx_put(eventfd);
+            }
+            return -ENOMEM;
+        }
+        spin_lock_init(&node->aio->lock);
+        INIT_LIST_HEAD(&node->aio->completed);
+    }
+
+    if (node->aio->eventfd) 
+    {
+        eventfd_ctx_put(node->aio->eventfd);
+    }
+    node->aio->eventfd = eventfd;
+    return 0;
+}
+
+static void ramdisk_aio_work(struct work_struct* work) 
+{
+    rdAioRequest* request;
+    ioctl_rd* params;
+    char* kernelAddress;
+    struct eventfd_ctx* eventfd;
+    unsigned long flags;
+    int fileSize;
+
+    request = container_of(work, rdAioRequest, work);
+    params = &request->sqe.params;
+
+    use_mm(request->mm);
+
+    switch (request->sqe.cmd) 
+    {
+        case IOCTL_RD_PREAD:
+            kernelAddress = allocBuffer(params->num_bytes);
+            if (!kernelAddress) 
+            {
+                request->ret = -1;
+                break;
+            }
+            request->ret = readFrozenInode(request->inodePointer, params->offset, kernelAddress, params->num_bytes);
+            if (request->ret == -2) 
+            {
+                request->ret = readSmallInode(request->inodePointer, params->offset, kernelAddress, params->num_bytes, &fileSize);
+            }
+            if (request->ret == -2) 
+            {
+                lockInode(request->inodePointer->inodeNumber, FALSE);
+                request->ret = readFromInode(request->inodePointer, params->offset, kernelAddress, params->num_bytes);
+                unlockInode(request->inodePointer->inodeNumber, FALSE);
+            }
+            if (request->ret > 0 && copy_to_user(params->address, kernelAddress, request->ret)) 
+            {
+                request->ret = -EFAULT;
+            }
+            freeBuffer(kernelAddress, params->num_bytes);
+            break;
+
+        case IOCTL_RD_PWRITE:
+            kernelAddress = allocBuffer(params->num_bytes);
+            if (!kernelAddress) 
+            {
+                request->ret = -1;
+                break;
+            }
+            if (copy_from_user(kernelAddress, params->address, params->num_bytes)) 
+            {
+                request->ret = -EFAULT;
+            }
+            else if (beginMutation() == -1) 
+            {
+                request->ret = -1;
+            }
+            else 
+            {
+                lockInode(request->inodePointer->inodeNumber, TRUE);
+                if (params->offset > request->inodePointer->size) 
+                {
+                    request->ret = -1;
+                }
+                else 
+                {
+                    request->ret = writeToInode(request->inodePointer, params->offset, kernelAddress, params->num_bytes);
+                }
+                unlockInode(request->inodePointer->inodeNumber, TRUE);
+                endMutation();
+            }
+            freeBuffer(kernelAddress, params->num_bytes);
+            break;
+
+        case IOCTL_RD_UNLINK:
+            request->ret = ram_unlink(request->path);
+            break;
+    }
+
+    unuse_mm(request->mm);
+    mmput(request->mm);
+
+    if (request->inodePointer) 
+    {
+        lockInode(request->inodePointer->inodeNumber, TRUE);
+        request->inodePointer->openCount--;
+        unlockInode(request->inodePointer->inodeNumber, TRUE);
+    }
+    if (request->path) 
+    {
+        freePath(request->path);
+        request->path = NULL;
+    }
+
+    //the request may be reaped and freed as soon as it is on the list
+    eventfd = request->eventfd;
+    spin_lock_irqsave(&request->context->lock, flags);
+    list_add_tail(&request->list, &request->context->completed);
+    spin_unlock_irqrestore(&request->context->lock, flags);
+
+    if (eventfd) 
+    {
+        rdEventfdSignal(eventfd);
+        eventfd_ctx_put(eventfd);
+    }
+}
+
+//queues a pread, pwrite or unlink and returns its request id at once;
+//the result is collected with IOCTL_RD_AIO_REAP
+static int ramdisk_aio_submit(rd_sqe* sqe) 
+{
+    fileDescriptorNode* node;
+    rdAioRequest* request;
+    ioctl_rd* params;
+
+    node = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (node == NULL || node->aio == NULL) 
+    {
+        return -1;
+    }
+
+    request = (rdAioRequest*) kzalloc(sizeof(rdAioRequest), GFP_KERNEL);
+    if (!request) 
+    {
+        return -ENOMEM;
+    }
+    //kernel threads have no address space for the worker to borrow
+    request->mm = get_task_mm(current);
+    if (!request->mm) 
+    {
+        kfree(request);
+        return -EFAULT;
+    }
+    request->sqe = *sqe;
+    params = &request->sqe.params;
+
+    switch (request->sqe.cmd) 
+    {
+        case IOCTL_RD_PREAD:
+        case IOCTL_RD_PWRITE:
+            if (params->fd < 0 || params->fd >= MAX_FILES_OPEN || params->offset < 0 || 
+                params->num_bytes < 0 || params->num_bytes > MAX_FILE_SIZE || 
+                node->fileDescriptorTable[params->fd].inodePointer == NULL) 
+            {
+                mmput(request->mm);
+                kfree(request);
+                return -1;
+            }
+            request->inodePointer = node->fileDescriptorTable[params->fd].inodePointer;
+            if (request->sqe.cmd == IOCTL_RD_PWRITE && strcmp(request->inodePointer->type, "reg") != 0) 
+            {
+                mmput(request->mm);
+                kfree(request);
+                return -1;
+            }
+            //once pinned the file cannot be unlinked, so the descriptor is
+            //checked only here
+            lockInode(request->inodePointer->inodeNumber, TRUE);
+            if (isStaleDescriptor(&node->fileDescriptorTable[params->fd])) 
+            {
+                unlockInode(request->inodePointer->inodeNumber, TRUE);
+                mmput(request->mm);
+                kfree(request);
+                return -1;
+            }
+            request->inodePointer->openCount++;
+            unlockInode(request->inodePointer->inodeNumber, TRUE);
+            break;
+
+        case IOCTL_RD_UNLINK:
+            request->path = copyPathFromUser(params);
+            if (!request->path) 
+            {
+                mmput(request->mm);
+                kfree(request);
+                return -1;
+            }
+            break;
+
+        default:
+            mmput(request->mm);
+            kfree(request);
+            return -EINVAL;
+    }
+
+    //a later IOCTL_RD_AIO_SETUP may drop the context's eventfd while this
+    //request is still queued, so it keeps its own reference
+    request->context = node->aio;
+    request->eventfd = node->aio->eventfd;
+    if (request->eventfd) 
+    {
+        eventfd_ctx_get(request->eventfd);
+    }
+    request->id = node->aio->nextId++;
+    INIT_WORK(&request->work, ramdisk_aio_work);
+    queue_work(aioWorkqueue, &request->work);
+
+    return request->id;
+}
+
+//copies up to maxEntries finished requests to the user's cqe array
+static int ramdisk_aio_reap(rd_cqe __user* cqes, int maxEntries) 
+{
+    fileDescriptorNode* node;
+    rdAioRequest* request;
+    rd_cqe cqe;
+    unsigned long flags;
+    int reaped;
+
+    node = findFileDescriptor(fileDescriptorProcessList, rdCurrentPid());
+    if (node == NULL || node->aio == NULL) 
+    {
+        return -1;
+    }
+
+    for (reaped = 0; reaped < maxEntries; reaped++) 
+    {
+        spin_lock_irqsave(&node->aio->lock, flags);
+        if (list_empty(&node->aio->completed)) 
+        {
+            spin_unlock_irqrestore(&node->aio->lock, flags);
+            break;
+        }
+        //workers only add at the tail and only the owner reaps, so the head
+        //stays put while it is copied out
+        request = list_first_entry(&node->aio->completed, rdAioRequest, list);
+        spin_unlock_irqrestore(&node->aio->lock, flags);
+
+        cqe.userData = request->sqe.userData;
+        cqe.ret = request->ret;
+        cqe.id = request->id;
+
+        //a completion that cannot be delivered stays queued for the next reap
+        if (copy_to_user(&cqes[reaped], &cqe, sizeof(rd_cqe))) 
+        {
+            return reaped > 0 ? reaped : -EFAULT;
+        }
+
+        spin_lock_irqsave(&node->aio->lock, flags);
+        list_del(&request->list);
+        spin_unlock_irqrestore(&node->aio->lock, flags);
+        kfree(request);
+    }
+
+    return reaped;
+}
+
+//drops every async context; the workqueue has been drained already
+static void ramdisk_aio_destroy(void) 
+{
+    fileDescriptorNode* node;
+    rdAioRequest* request;
+    rdAioRequest* next;
+
+    for (node = fileDescriptorProcessList; node; node = node->next) 
+    {
+        if (node->aio == NULL) 
+        {
+            continue;
+        }
+
+        list_for_each_entry_safe(request, next, &node->aio->completed, list) 
+        {
+            kfree(request);
+        }
+        if (node->aio->eventfd) 
+        {
+            eventfd_ctx_put(node->aio->eventfd);
+        }
+        kfree(node->aio);
+        node->aio = NULL;
+    }
+}
+
+//latency of every ioctl by command number, in log2 buckets of nanoseconds:
+//bucket b counts calls that took [2^(b-1), 2^b) ns, the last one the rest
+#define RD_LATENCY_COMMANDS 25
+#define RD_LATENCY_BUCKETS 32
+
+typedef struct {
+    unsigned long buckets[RD_LATENCY_COMMANDS][RD_LATENCY_BUCKETS];
+} rdLatencyHistogram;
+
+static DEFINE_PER_CPU(rdLatencyHistogram, rdLatency);
+
+static const char* rdCommandNames[RD_LATENCY_COMMANDS] = {
+    "creat", "mkdir", "open", "close", "read", "write", "lseek", "unlink",
+    "readdir", "mmap", "pread", "pwrite", "readv", "writev", "ring_setup",
+    "ring_enter", "readfile", "writefile", "openfile", "sendfile",
+    "aio_setup", "aio_submit", "aio_reap", "freeze", "thaw"
+};
+
+static void recordLatency(unsigned int cmd, u64 start) 
+{
+    unsigned int bucket;
+
+    if (_IOC_TYPE(cmd) != MAJOR_NUM || _IOC_NR(cmd) >= RD_LATENCY_COMMANDS) 
+    {
+        return;
+    }
+    bucket = min(fls64(ktime_get_ns() - start), RD_LATENCY_BUCKETS - 1);
+    this_cpu_inc(rdLatency.buckets[_IOC_NR(cmd)][bucket]);
+}
+
+//one "command low_ns high_ns count" line per bucket that has any calls
+static int ramdisk_latency_show(struct seq_file* m, void* v) 
+{
+    unsigned long count;
+    int command, bucket, cpu;
+
+    for (command = 0; command < RD_LATENCY_COMMANDS; command++) 
+    {
+        for (bucket = 0; bucket < RD_LATENCY_BUCKETS; bucket++) 
+        {
+            count = 0;
+            for_each_possible_cpu(cpu) 
+            {
+                count += per_cpu(rdLatency, cpu).buckets[command][bucket];
+            }
+            if (count == 0) 
+            {
+                continue;
+            }
+            seq_printf(m, "%s %llu %llu %lu\n", rdCommandNames[command], 
+                       bucket ? 1ULL << (bucket - 1) : 0ULL, 
+                       bucket < RD_LATENCY_BUCKETS - 1 ? (1ULL << bucket) - 1 : ~0ULL, count);
+        }
+    }
+    return 0;
+}
+
+static int ramdisk_latency_open(struct inode* node, struct file* file) 
+{
+    return single_open(file, ramdisk_latency_show, NULL);
+}
+
+//any write clears the histograms; calls in flight on other cpus may still
+//land in the old counts
+static ssize_t ramdisk_latency_write(struct file* file, const char __user* buf, size_t count, loff_t* ppos) 
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu) 
+    {
+        memset(per_cpu_ptr(&rdLatency, cpu), 0, sizeof(rdLatencyHistogram));
+    }
+    return count;
+}
+
+// ioctl for the ramdisk 
+//runs a command whose ioctl_rd has been copied in already
+static long ramdisk_command(unsigned int cmd, ioctl_rd* params) 
+{
+    switch (cmd) 
+    {
+        case IOCTL_RD_RING_SETUP://attach a ring
+            return ramdisk_ring_setup();
+
+        case IOCTL_RD_RING_ENTER://drain the ring
+            return ramdisk_ring_enter(params->num_bytes);
+
+        case IOCTL_RD_AIO_SETUP://attach an async context
+            return ramdisk_aio_setup(params->fd);
+
+        case IOCTL_RD_AIO_REAP://collect async completions
+            return ramdisk_aio_reap((rd_cqe __user*) params->address, params->num_bytes);
+
+        default:
+            return ramdisk_dispatch(cmd, params);
+    }
+}
+
+//runs without any global lock, the filesystem locks for itself
+static long ramdisk_native_ioctl(unsigned int cmd, unsigned long arg) 
+{
+    ioctl_rd params;
+    rd_sqe sqe;
+
+    //the only command that does not carry an ioctl_rd
+    if (cmd == IOCTL_RD_AIO_SUBMIT) 
+    {
+        if (copy_from_user(&sqe, (rd_sqe __user*) arg, sizeof(rd_sqe))) 
+        {
+            return -EFAULT;
+        }
+        return ramdisk_aio_submit(&sqe);
+    }
+
+    if (copy_from_user(&params, (ioctl_rd __user*) arg, sizeof(ioctl_rd))) 
+    {
+        return -EFAULT;
+    }
+
+    return ramdisk_command(cmd, &params);
+}
+
+static long ramdisk_ioctl(struct file *file, unsigned int cmd, unsigned long arg) 
+{
+    u64 start;
+    long ret;
+
+    start = ktime_get_ns();
+    ret = ramdisk_native_ioctl(cmd, arg);
+    recordLatency(cmd, start);
+    return ret;
+}
+
+#ifdef CONFIG_COMPAT
+// ioctl_rd and rd_sqe as laid out by 32-bit clients
+typedef struct {
+    compat_uptr_t pathname;
+    int pathnameLength;
+    int fd;
+    compat_uptr_t address;
+    int addressLength;
+    int num_bytes;
+    int offset;
+    compat_uptr_t iov;
+    int iovcnt;
+    int outFd;
+    int ret;
+} ioctl_rd32;
+
+typedef struct {
+    unsigned int cmd;
+    ioctl_rd32 params;
+    compat_u64 userData;
+} rd_sqe32;
+
+//the command numbers encode the size of their argument, which differs
+//for 32-bit clients; returns the native command
+static unsigned int compatCommand(unsigned int cmd) 
+{
+    if (cmd == _IOWR(MAJOR_NUM, _IOC_NR(IOCTL_RD_AIO_SUBMIT), rd_sqe32)) 
+    {
+        return IOCTL_RD_AIO_SUBMIT;
+    }
+    if (cmd == _IOWR(MAJOR_NUM, _IOC_NR(cmd), ioctl_rd32)) 
+    {
+        return _IOWR(MAJOR_NUM, _IOC_NR(cmd), ioctl_rd);
+    }
+    return cmd;
+}
+
+static void compatParams(ioctl_rd* params, ioctl_rd32* params32) 
+{
+    params->pathname = compat_ptr(params32->pathname);
+    params->pathnameLength = params32->pathnameLength;
+    params->fd = params32->fd;
+    params->address = compat_ptr(params32->address);
+    params->addressLength = params32->addressLength;
+    params->num_bytes = params32->num_bytes;
+    params->offset = params32->offset;
+    params->iov = compat_ptr(params32->iov);
+    params->iovcnt = params32->iovcnt;
+    params->outFd = params32->outFd;
+    params->ret = params32->ret;
+}
+
+//32-bit clients; the vectored commands and the ring are refused since the
+//iovec array and the shared sqes hold native pointers
+static long ramdisk_compat_command(unsigned int cmd, unsigned long arg) 
+{
+    ioctl_rd32 params32;
+    ioctl_rd params;
+    rd_sqe32 sqe32;
+    rd_sqe sqe;
+
+    cmd = compatCommand(cmd);
+    switch (cmd) 
+    {
+        case IOCTL_RD_READV:
+        case IOCTL_RD_WRITEV:
+        case IOCTL_RD_RING_SETUP:
+        case IOCTL_RD_RING_ENTER:
+            return -EINVAL;
+
+        case IOCTL_RD_AIO_SUBMIT:
+            if (copy_from_user(&sqe32, compat_ptr(arg), sizeof(rd_sqe32))) 
+            {
+                return -EFAULT;
+            }
+            sqe.cmd = compatCommand(sqe32.cmd);
+            if (sqe.cmd == IOCTL_RD_READV || sqe.cmd == IOCTL_RD_WRITEV) 
+            {
+                return -EINVAL;
+            }
+            compatParams(&sqe.params, &sqe32.params);
+            sqe.userData = sqe32.userData;
+            return ramdisk_aio_submit(&sqe);
+    }
+
+    if (copy_from_user(&params32, compat_ptr(arg), sizeof(ioctl_rd32))) 
+    {
+        return -EFAULT;
+    }
+    compatParams(&params, &params32);
+
+    return ramdisk_command(cmd, &params);
+}
+
+static long ramdisk_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg) 
+{
+    u64 start;
+    long ret;
+
+    start = ktime_get_ns();
+    ret = ramdisk_compat_command(cmd, arg);
+    recordLatency(cmd, start);
+    return ret;
+}
+#endif
+
+//an image being read from the backup entry, see rd_image_header: the
+//inodes and blocks it holds are listed when it is opened and copied out
+//of the ramdisk as they are read
+typedef struct {
+    rd_image_header header;
+    int size;
+    short* inodes;
+    int* blocks;
+} rdBackup;
+
+static void freeBackup(rdBackup* backup) 
+{
+    kfree(backup->inodes);
+    vfree(backup->blocks);
+    kfree(backup);
+}
+
+//holds the filesystem frozen and lists what the image holds; nothing can
+//change until every open image is closed, IOCTL_RD_THAW included
+static int ramdisk_backup_open(struct inode* node, struct file* file) 
+{
+    rdBackup* backup;
+    int i, ret;
+
+    backup = (rdBackup*) kzalloc(sizeof(rdBackup), GFP_KERNEL);
+    if (!backup) 
+    {
+        return -ENOMEM;
+    }
+    backup->inodes = (short*) kmalloc(INODE_COUNT * sizeof(short), GFP_KERNEL);
+    backup->blocks = (int*) vmalloc(RD_BLOCK_COUNT * sizeof(int));
+    if (!backup->inodes || !backup->blocks) 
+    {
+        freeBackup(backup);
+        return -ENOMEM;
+    }
+
+    ret = holdFreeze();
+    if (ret != 0) 
+    {
+        freeBackup(backup);
+        return ret;
+    }
+
+    memcpy(backup->header.magic, RD_IMAGE_MAGIC, sizeof(RD_IMAGE_MAGIC));
+    backup->header.version = RD_IMAGE_VERSION;
+    backup->header.blockSize = RD_BLOCK_SIZE;
+    backup->header.blockCount = RD_BLOCK_COUNT;
+    backup->header.inodeCount = INODE_COUNT;
+    backup->header.inodeSize = INODE_STRUCTURE_SIZE;
+    backup->header.bitmapSize = BLOCK_BITMAP_SIZE;
+    backup->header.freeBlocks = sb->freeBlocks;
+    backup->header.freeInodes = sb->freeInodes;
+    backup->header.blockBase = (unsigned long) sb->freeBlockStart;
+
+    for (i = 0; i < INODE_COUNT; i++) 
+    {
+        if (inodeArray[i].status == ALLOCATED) 
+        {
+            backup->inodes[backup->header.imageInodes++] = i;
+        }
+    }
+    for (i = 0; i < RD_BLOCK_COUNT; i++) 
+    {
+        if (getBit((unsigned int *)(sb->blockBitmapStart + i / 8), bitPosition(i % 8)) != FREE) 
+        {
+            backup->blocks[backup->header.imageBlocks++] = i;
+        }
+    }
+
+    backup->size = sizeof(rd_image_header) + backup->header.imageInodes * INODE_STRUCTURE_SIZE + 
+                   BLOCK_BITMAP_SIZE + backup->header.imageBlocks * RD_BLOCK_SIZE;
+    file->private_data = backup;
+    return 0;
+}
+
+//finds the bytes at position of the image; returns how many follow there
+//contiguously, 0 past the end
+static int backupSource(rdBackup* backup, int position, char** source) 
+{
+    int record;
+
+    if (position < (int) sizeof(rd_image_header)) 
+    {
+        *source = (char*) &backup->header + position;
+        return sizeof(rd_image_header) - position;
+    }
+    position -= sizeof(rd_image_header);
+
+    if (position < backup->header.imageInodes * INODE_STRUCTURE_SIZE) 
+    {
+        record = position / INODE_STRUCTURE_SIZE;
+        *source = (char*) &inodeArray[backup->inodes[record]] + position % INODE_STRUCTURE_SIZE;
+        return INODE_STRUCTURE_SIZE - position % INODE_STRUCTURE_SIZE;
+    }
+    position -= backup->header.imageInodes * INODE_STRUCTURE_SIZE;
+
+    if (position < BLOCK_BITMAP_SIZE) 
+    {
+        *source = sb->blockBitmapStart + position;
+        return BLOCK_BITMAP_SIZE - position;
+    }
+    position -= BLOCK_BITMAP_SIZE;
+
+    if (position < backup->header.imageBlocks * RD_BLOCK_SIZE) 
+    {
+        record = position / RD_BLOCK_SIZE;
+        *source = sb->freeBlockStart + backup->blocks[record] * RD_BLOCK_SIZE + position % RD_BLOCK_SIZE;
+        return RD_BLOCK_SIZE - position % RD_BLOCK_SIZE;
+    }
+    return 0;
+}
+
+//copies the image straight from the frozen ramdisk to the reader
+static ssize_t ramdisk_backup_read(struct file* file, char __user* buf, size_t count, loff_t* ppos) 
+{
+    rdBackup* backup;
+    char* source;
+    size_t copied;
+    int chunk;
+
+    backup = (rdBackup*) file->private_data;
+    copied = 0;
+    while (copied < count && *ppos < backup->size) 
+    {
+        chunk = backupSource(backup, (int) *ppos, &source);
+        chunk = min_t(size_t, chunk, count - copied);
+        if (copy_to_user(buf + copied, source, chunk)) 
+        {
+            return copied ? copied : -EFAULT;
+        }
+        copied += chunk;
+        *ppos += chunk;
+    }
+    return copied;
+}
+
+static int ramdisk_backup_release(struct inode* node, struct file* file) 
+{
+    rdBackup* backup;
+
+    backup = (rdBackup*) file->private_data;
+    releaseFreeze();
+    freeBackup(backup);
+    return 0;
+}
+
+//one "name value" line per counter, then the state of the filesystem
+static int ramdisk_stats_show(struct seq_file* m, void* v) 
+{
+    int processes, descriptors;
+    int i;
+
+    for (i = 0; i < RD_STAT_COUNT; i++) 
+    {
+        seq_printf(m, "%s %lu\n", rdStatNames[i], rdStatSum(i));
+    }
+
+    rdDescriptorCounts(&processes, &descriptors);
+    seq_printf(m, "free_blocks %u\n", sb->freeBlocks);
+    seq_printf(m, "free_inodes %u\n", sb->freeInodes);
+    seq_printf(m, "open_descriptors %d\n", descriptors);
+    seq_printf(m, "process_tables %d\n", processes);
+    return 0;
+}
+
+static int ramdisk_stats_open(struct inode* node, struct file* file) 
+{
+    return single_open(file, ramdisk_stats_show, NULL);
+}
+
+//prints the "low high count" lines of a space histogram with any counts
+static void printSpaceHistogram(struct seq_file* m, char* name, int* buckets) 
+{
+    int bucket;
+
+    for (bucket = 0; bucket < RD_SPACE_BUCKETS; bucket++) 
+    {
+        if (buckets[bucket] == 0) 
+        {
+            continue;
+        }
+        if (bucket < RD_SPACE_BUCKETS - 1) 
+        {
+            seq_printf(m, "%s %d %d %d\n", name, 1 << bucket, (2 << bucket) - 1, buckets[bucket]);
+        }
+        else 
+        {
+            seq_printf(m, "%s %d - %d\n", name, 1 << bucket, buckets[bucket]);
+        }
+    }
+}
+
+//occupancy and fragmentation, one "name value" line each; the overhead
+//and share lines are in thousandths
+static int ramdisk_space_show(struct seq_file* m, void* v) 
+{
+    spaceReport* report;
+    int usedBlocks, fileBlocks, directoryBlocks;
+
+    report = (spaceReport*) kmalloc(sizeof(spaceReport), GFP_KERNEL);
+    if (!report) 
+    {
+        return -ENOMEM;
+    }
+    analyzeSpace(report);
+
+    fileBlocks = report->fileDataBlocks + report->fileIndexBlocks;
+    directoryBlocks = report->directoryDataBlocks + report->directoryIndexBlocks;
+    usedBlocks = fileBlocks + directoryBlocks;
+
+    seq_printf(m, "blocks %d\n", report->totalBlocks);
+    seq_printf(m, "free_blocks %d\n", report->freeBlocks);
+    seq_printf(m, "free_extents %d\n", report->freeExtents);
+    seq_printf(m, "largest_free_extent %d\n", report->largestFreeExtent);
+    printSpaceHistogram(m, "free_extent_blocks", report->freeExtentSizes);
+
+    seq_printf(m, "files %d\n", report->files);
+    seq_printf(m, "directories %d\n", report->directories);
+    seq_printf(m, "file_extents %d\n", report->fileExtents);
+    seq_printf(m, "most_file_extents %d\n", report->mostFileExtents);
+    printSpaceHistogram(m, "file_extent_count", report->fileExtentCounts);
+
+    seq_printf(m, "file_data_blocks %d\n", report->fileDataBlocks);
+    seq_printf(m, "file_index_blocks %d\n", report->fileIndexBlocks);
+    seq_printf(m, "index_overhead_permille %d\n", 
+               report->fileDataBlocks ? report->fileIndexBlocks * 1000 / report->fileDataBlocks : 0);
+    seq_printf(m, "directory_data_blocks %d\n", report->directoryDataBlocks);
+    seq_printf(m, "directory_index_blocks %d\n", report->directoryIndexBlocks);
+    seq_printf(m, "directory_share_permille %d\n", usedBlocks ? directoryBlocks * 1000 / usedBlocks : 0);
+    seq_printf(m, "inline_capable_files %d\n", report->inlineFiles);
+    seq_printf(m, "inline_size %d\n", RD_INLINE_SIZE);
+
+    kfree(report);
+    return 0;
+}
+
+static int ramdisk_space_open(struct inode* node, struct file* file) 
+{
+    return single_open(file, ramdisk_space_show, NULL);
+}
+
+static int __init init_ramdisk(void) {
+    int ret;
+
+    aioWorkqueue = create_workqueue("ramdisk_aio");
+    if (!aioWorkqueue) 
+    {
+        return -ENOMEM;
+    }
+
+#ifdef RD_HAVE_PROC_OPS
+    ramdiskOperations.proc_ioctl = ramdisk_ioctl;
+#ifdef CONFIG_COMPAT
+    ramdiskOperations.proc_compat_ioctl = ramdisk_compat_ioctl;
+#endif
+    ramdiskOperations.proc_mmap = ramdisk_mmap;
+    ramdiskStatsOperations.proc_open = ramdisk_stats_open;
+    ramdiskStatsOperations.proc_read = seq_read;
+    ramdiskStatsOperations.proc_lseek = seq_lseek;
+    ramdiskStatsOperations.proc_release = single_release;
+    ramdiskLatencyOperations.proc_open = ramdisk_latency_open;
+    ramdiskLatencyOperations.proc_read = seq_read;
+    ramdiskLatencyOperations.proc_write = ramdisk_latency_write;
+    ramdiskLatencyOperations.proc_lseek = seq_lseek;
+    ramdiskLatencyOperations.proc_release = single_release;
+    ramdiskSpaceOperations.proc_open = ramdisk_space_open;
+    ramdiskSpaceOperations.proc_read = seq_read;
+    ramdiskSpaceOperations.proc_lseek = seq_lseek;
+    ramdiskSpaceOperations.proc_release = single_release;
+    ramdiskBackupOperations.proc_open = ramdisk_backup_open;
+    ramdiskBackupOperations.proc_read = ramdisk_backup_read;
+    ramdiskBackupOperations.proc_lseek = default_llseek;
+    ramdiskBackupOperations.proc_release = ramdisk_backup_release;
+#else
+    ramdiskOperations.owner = THIS_MODULE;
+    ramdiskOperations.unlocked_ioctl = ramdisk_ioctl;
+#ifdef CONFIG_COMPAT
+    ramdiskOperations.compat_ioctl = ramdisk_compat_ioctl;
+#endif
+    ramdiskOperations.mmap = ramdisk_mmap;
+    ramdiskBackupOperations.owner = THIS_MODULE;
+    ramdiskBackupOperations.open = ramdisk_backup_open;
+    ramdiskBackupOperations.read = ramdisk_backup_read;
+    ramdiskBackupOperations.llseek = default_llseek;
+    ramdiskBackupOperations.release = ramdisk_backup_release;
+    ramdiskStatsOperations.owner = THIS_MODULE;
+    ramdiskStatsOperations.open = ramdisk_stats_open;
+    ramdiskStatsOperations.read = seq_read;
+    ramdiskStatsOperations.llseek = seq_lseek;
+    ramdiskStatsOperations.release = single_release;
+    ramdiskLatencyOperations.owner = THIS_MODULE;
+    ramdiskLatencyOperations.open = ramdisk_latency_open;
+    ramdiskLatencyOperations.read = seq_read;
+    ramdiskLatencyOperations.write = ramdisk_latency_write;
+    ramdiskLatencyOperations.llseek = seq_lseek;
+    ramdiskLatencyOperations.release = single_release;
+    ramdiskSpaceOperations.owner = THIS_MODULE;
+    ramdiskSpaceOperations.open = ramdisk_space_open;
+    ramdiskSpaceOperations.read = seq_read;
+    ramdiskSpaceOperations.llseek = seq_lseek;
+    ramdiskSpaceOperations.release = single_release;
+#endif
+
+    ramdiskFileOperations.owner = THIS_MODULE;
+#ifdef RD_HAVE_RW_ITER
+    ramdiskFileOperations.read_iter = ramdisk_file_read_iter;
+    ramdiskFileOperations.write_iter = ramdisk_file_write_iter;
+#else
+    ramdiskFileOperations.read = ramdisk_file_read;
+    ramdiskFileOperations.write = ramdisk_file_write;
+#endif
+    ramdiskFileOperations.llseek = ramdisk_file_llseek;
+    ramdiskFileOperations.release = ramdisk_file_release;
+
+    ramdiskVmOperations.open = ramdisk_vma_open;
+    ramdiskVmOperations.close = ramdisk_vma_close;
+    ramdiskVmOperations.fault = ramdisk_vma_fault;
+
+    ret = initRamdisk();
+    if (ret < 0) 
+    {
+        destroyRamdisk();
+        destroy_workqueue(aioWorkqueue);
+        return -ENOMEM;
+    }
+
+    //0666: the ring is mapped writable, which needs the entry open O_RDWR
+    proc_entry = proc_create("ramdisk_ioctl", 0666, NULL, &ramdiskOperations);
+    proc_backup = proc_create("ramdisk_backup", 0400, NULL, &ramdiskBackupOperations);
+    proc_stats = proc_create("ramdisk_stats", 0444, NULL, &ramdiskStatsOperations);
+    proc_latency = proc_create("ramdisk_latency", 0644, NULL, &ramdiskLatencyOperations);
+    proc_space = proc_create("ramdisk_space", 0444, NULL, &ramdiskSpaceOperations);
+    if (!proc_entry || !proc_backup || !proc_stats || !proc_latency || !proc_space) 
+    {
+        if (proc_entry) 
+        {
+            remove_proc_entry("ramdisk_ioctl", NULL);
+        }
+        if (proc_backup) 
+        {
+            remove_proc_entry("ramdisk_backup", NULL);
+        }
+        if (proc_stats) 
+        {
+            remove_proc_entry("ramdisk_stats", NULL);
+        }
+        if (proc_latency) 
+        {
+            remove_proc_entry("ramdisk_latency", NULL);
+        }
+        if (proc_space) 
+        {
+            remove_proc_entry("ramdisk_space", NULL);
+        }
+        destroyRamdisk();
+        destroy_workqueue(aioWorkqueue);
+        return -ENOMEM;
+    }
+
+    return ret;
+}
+
+static void __exit exit_ramdisk(void) 
+{
+    //no new calls can start once the entries are gone
+    remove_proc_entry("ramdisk_ioctl", NULL);
+    remove_proc_entry("ramdisk_backup", NULL);
+    remove_proc_entry("ramdisk_stats", NULL);
+    remove_proc_entry("ramdisk_latency", NULL);
+    remove_proc_entry("ramdisk_space", NULL);
+
+    destroy_workqueue(aioWorkqueue);
+    ramdisk_aio_destroy();
+    destroyRamdisk();
+
+    return;
+}
+
+MODULE_LICENSE("GPL");
+
+module_init(init_ramdisk);
+module_exit(exit_ramdisk);
@@ -0,0 +1,286 @@
+/*
+ * ramdisk_platform.h - what the filesystem core needs from its host
+ * The core in ramdisk_core.c is written against the kernel interfaces
+ * below. Inside the module they are the real ones; built without
+ * __KERNEL__ they map onto libc and pthreads, so the same core links
+ * into an ordinary process as libramdisk.a.
+ */
+
+#ifndef RAMDISK_PLATFORM_H
+#define RAMDISK_PLATFORM_H
+
+#ifdef __KERNEL__
+
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+#include <linux/errno.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/rwsem.h>
+#include <linux/seqlock.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/percpu.h>
+#include <asm/string.h>
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 3, 0)
+#define strscpy strlcpy
+#endif
+
+#ifndef ACCESS_ONCE
+#define ACCESS_ONCE(x) READ_ONCE(x)
+#endif
+
+//the descriptor tables belong to the calling task
+static inline int rdCurrentPid(void)
+{
+    return current->pid;
+}
+
+#else
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 4096
+#endif
+
+#define BLOCK_SIZE 1024
+#define offset_in_page(p) ((unsigned long) (p) & (PAGE_SIZE - 1))
+
+#define GFP_KERNEL 0
+#define __user
+#define KERN_DEBUG ""
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+//notices of the core such as freeze and thaw; only wanted when debugging.
+//Per-operation messages are rdDebug, see ramdisk.h
+#ifdef RD_VERBOSE
+#define printk(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define printk(...) ((void) 0)
+#endif
+
+#define WARN_ON_ONCE(condition) ({                                          \
+    int warned = !!(condition);                                             \
+    if (unlikely(warned))                                                   \
+    {                                                                       \
+        fprintf(stderr, "ramdisk: warning at %s:%d\n", __FILE__, __LINE__); \
+    }                                                                       \
+    warned;                                                                 \
+})
+
+//memory; vmalloc memory is page aligned, which the block groups rely on
+static inline void* vmalloc(unsigned long size)
+{
+    void* address;
+
+    if (posix_memalign(&address, PAGE_SIZE, size) != 0)
+    {
+        return NULL;
+    }
+    return address;
+}
+
+static inline void vfree(const void* address)
+{
+    free((void*) address);
+}
+
+struct kmem_cache {
+    size_t size;
+};
+
+static inline struct kmem_cache* kmem_cache_create(const char* name, size_t size, size_t align, unsigned long flags, void* ctor)
+{
+    struct kmem_cache* cache;
+
+    cache = (struct kmem_cache*) malloc(sizeof(struct kmem_cache));
+    if (cache)
+    {
+        cache->size = size;
+    }
+    return cache;
+}
+
+static inline void* kmem_cache_alloc(struct kmem_cache* cache, int flags)
+{
+    return malloc(cache->size);
+}
+
+static inline void kmem_cache_free(struct kmem_cache* cache, void* object)
+{
+    free(object);
+}
+
+static inline void kmem_cache_destroy(struct kmem_cache* cache)
+{
+    free(cache);
+}
+
+static inline size_t strscpy(char* dest, const char* src, size_t count)
+{
+    size_t length;
+
+    length = strnlen(src, count - 1);
+    memcpy(dest, src, length);
+    dest[length] = '\0';
+    return length;
+}
+
+//ordering
+#define ACCESS_ONCE(x) (*(volatile __typeof__(x)*) &(x))
+#define smp_mb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#define preempt_disable() do { } while (0)
+#define preempt_enable() do { } while (0)
+
+//per-cpu data; a single copy updated atomically
+#define DEFINE_PER_CPU(type, name) type name
+#define DECLARE_PER_CPU(type, name) extern type name
+#define per_cpu(var, cpu) (var)
+#define for_each_possible_cpu(cpu) for ((cpu) = 0; (cpu) < 1; (cpu)++)
+#define this_cpu_add(var, amount) __atomic_fetch_add(&(var), (amount), __ATOMIC_RELAXED)
+#define this_cpu_inc(var) this_cpu_add(var, 1)
+
+//locks
+struct rw_semaphore {
+    pthread_rwlock_t lock;
+};
+
+#define DECLARE_RWSEM(name) struct rw_semaphore name = { PTHREAD_RWLOCK_INITIALIZER }
+
+static inline void init_rwsem(struct rw_semaphore* sem)
+{
+    pthread_rwlock_init(&sem->lock, NULL);
+}
+
+static inline void down_read(struct rw_semaphore* sem)
+{
+    pthread_rwlock_rdlock(&sem->lock);
+}
+
+static inline void up_read(struct rw_semaphore* sem)
+{
+    pthread_rwlock_unlock(&sem->lock);
+}
+
+static inline void down_write(struct rw_semaphore* sem)
+{
+    pthread_rwlock_wrlock(&sem->lock);
+}
+
+static inline void up_write(struct rw_semaphore* sem)
+{
+    pthread_rwlock_unlock(&sem->lock);
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+} spinlock_t;
+
+#define DEFINE_SPINLOCK(name) spinlock_t name = { PTHREAD_MUTEX_INITIALIZER }
+
+static inline void spin_lock(spinlock_t* lock)
+{
+    pthread_mutex_lock(&lock->lock);
+}
+
+static inline void spin_unlock(spinlock_t* lock)
+{
+    pthread_mutex_unlock(&lock->lock);
+}
+
+//sequence counts, odd while a writer is inside
+typedef struct {
+    unsigned int sequence;
+} seqcount_t;
+
+static inline void seqcount_init(seqcount_t* s)
+{
+    s->sequence = 0;
+}
+
+static inline unsigned int read_seqcount_begin(seqcount_t* s)
+{
+    unsigned int sequence;
+
+    while ((sequence = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)) & 1)
+    {
+        sched_yield();
+    }
+    return sequence;
+}
+
+static inline int read_seqcount_retry(seqcount_t* s, unsigned int start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->sequence, __ATOMIC_RELAXED) != start;
+}
+
+static inline void write_seqcount_begin(seqcount_t* s)
+{
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_seqcount_end(seqcount_t* s)
+{
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELEASE);
+}
+
+//RCU; a read section holds a process-wide rwlock shared, and a grace
+//period is taking it exclusively once, so it ends after every section
+//that had begun
+extern pthread_rwlock_t rdRcuLock;
+
+static inline void rcu_read_lock(void)
+{
+    pthread_rwlock_rdlock(&rdRcuLock);
+}
+
+static inline void rcu_read_unlock(void)
+{
+    pthread_rwlock_unlock(&rdRcuLock);
+}
+
+static inline void synchronize_rcu(void)
+{
+    pthread_rwlock_wrlock(&rdRcuLock);
+    pthread_rwlock_unlock(&rdRcuLock);
+}
+
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+//every thread has a descriptor table of its own, as every task does in
+//the kernel; the id is looked up once per thread
+static inline int rdCurrentPid(void)
+{
+    static __thread int pid;
+
+    if (!pid)
+    {
+        pid = (int) syscall(SYS_gettid);
+    }
+    return pid;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * ramdisk_trace.h - tracepoints of the ramdisk
+ * Static instrumentation for perf, ftrace and bpftrace under the
+ * "ramdisk" system: entry and exit of every ram_* operation, block
+ * allocation and release, path lookups and new descriptor tables.
+ * Disabled tracepoints cost a patched-out branch. ramdisk_kmod.c defines
+ * CREATE_TRACE_POINTS before including this file; in userspace the
+ * events compile to nothing.
+ */
+
+#ifdef __KERNEL__
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ramdisk
+
+#if !defined(RAMDISK_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define RAMDISK_TRACE_H
+
+#include <linux/tracepoint.h>
+#include "ramdisk.h"
+
+// operations are numbered as their statistics counters
+TRACE_DEFINE_ENUM(RD_STAT_CREAT);
+TRACE_DEFINE_ENUM(RD_STAT_MKDIR);
+TRACE_DEFINE_ENUM(RD_STAT_OPEN);
+TRACE_DEFINE_ENUM(RD_STAT_CLOSE);
+TRACE_DEFINE_ENUM(RD_STAT_READ);
+TRACE_DEFINE_ENUM(RD_STAT_WRITE);
+TRACE_DEFINE_ENUM(RD_STAT_LSEEK);
+TRACE_DEFINE_ENUM(RD_STAT_UNLINK);
+TRACE_DEFINE_ENUM(RD_STAT_READDIR);
+TRACE_DEFINE_ENUM(RD_STAT_MMAP);
+TRACE_DEFINE_ENUM(RD_STAT_READFILE);
+TRACE_DEFINE_ENUM(RD_STAT_WRITEFILE);
+TRACE_DEFINE_ENUM(RD_STAT_OPENFILE);
+TRACE_DEFINE_ENUM(RD_STAT_FREEZE);
+TRACE_DEFINE_ENUM(RD_STAT_THAW);
+
+#define rdTraceOpName(op)                       \
+    __print_symbolic(op,                        \
+        { RD_STAT_CREAT, "creat" },             \
+        { RD_STAT_MKDIR, "mkdir" },             \
+        { RD_STAT_OPEN, "open" },               \
+        { RD_STAT_CLOSE, "close" },             \
+        { RD_STAT_READ, "read" },               \
+        { RD_STAT_WRITE, "write" },             \
+        { RD_STAT_LSEEK, "lseek" },             \
+        { RD_STAT_UNLINK, "unlink" },           \
+        { RD_STAT_READDIR, "readdir" },         \
+        { RD_STAT_MMAP, "mmap" },               \
+        { RD_STAT_READFILE, "readfile" },       \
+        { RD_STAT_WRITEFILE, "writefile" },     \
+        { RD_STAT_OPENFILE, "openfile" },       \
+        { RD_STAT_FREEZE, "freeze" },           \
+        { RD_STAT_THAW, "thaw" })
+
+// fd is -1 for operations on a path, and so is inode until the path is
+// resolved; offset -1 stands for the position of the descriptor, which is
+// recorded instead
+TRACE_EVENT(ramdisk_op_enter,
+
+    TP_PROTO(int op, int fd, int inodeNumber, int offset, int length),
+
+    TP_ARGS(op, fd, inodeNumber, offset, length),
+
+    TP_STRUCT__entry(
+        __field(int, pid)
+        __field(int, op)
+        __field(int, fd)
+        __field(int, inode)
+        __field(int, offset)
+        __field(int, length)
+    ),
+
+    TP_fast_assign(
+        __entry->pid = current->pid;
+        __entry->op = op;
+        __entry->fd = fd;
+        __entry->inode = inodeNumber;
+        __entry->offset = offset >= 0 ? offset : rdDescriptorPosition(fd);
+        __entry->length = length;
+    ),
+
+    TP_printk("pid=%d op=%s fd=%d inode=%d offset=%d length=%d",
+              __entry->pid, rdTraceOpName(__entry->op), __entry->fd,
+              __entry->inode, __entry->offset, __entry->length)
+);
+
+// inode is the one the operation resolved or worked on, -1 if none
+TRACE_EVENT(ramdisk_op_exit,
+
+    TP_PROTO(int op, int inodeNumber, int result),
+
+    TP_ARGS(op, inodeNumber, result),
+
+    TP_STRUCT__entry(
+        __field(int, pid)
+        __field(int, op)
+        __field(int, inode)
+        __field(int, result)
+    ),
+
+    TP_fast_assign(
+        __entry->pid = current->pid;
+        __entry->op = op;
+        __entry->inode = inodeNumber;
+        __entry->result = result;
+    ),
+
+    TP_printk("pid=%d op=%s inode=%d result=%d",
+              __entry->pid, rdTraceOpName(__entry->op), __entry->inode,
+              __entry->result)
+);
+
+DECLARE_EVENT_CLASS(ramdisk_block,
+
+    TP_PROTO(int block, int count, unsigned int freeBlocks),
+
+    TP_ARGS(block, count, freeBlocks),
+
+    TP_STRUCT__entry(
+        __field(int, block)
+        __field(int, count)
+        __field(unsigned int, freeBlocks)
+    ),
+
+    TP_fast_assign(
+        __entry->block = block;
+        __entry->count = count;
+        __entry->freeBlocks = freeBlocks;
+    ),
+
+    TP_printk("block=%d count=%d free=%u",
+              __entry->block, __entry->count, __entry->freeBlocks)
+);
+
+// count blocks starting at block taken from the bitmap, free left after
+DEFINE_EVENT(ramdisk_block, ramdisk_alloc_block,
+    TP_PROTO(int block, int count, unsigned int freeBlocks),
+    TP_ARGS(block, count, freeBlocks)
+);
+
+// block given back to the bitmap, free left after
+DEFINE_EVENT(ramdisk_block, ramdisk_free_block,
+    TP_PROTO(int block, int count, unsigned int freeBlocks),
+    TP_ARGS(block, count, freeBlocks)
+);
+
+// one lockless path lookup: components walked and directory blocks
+// searched, retries included; inode is -1 if the path does not resolve
+TRACE_EVENT(ramdisk_lookup,
+
+    TP_PROTO(int inodeNumber, int depth, int blocksScanned),
+
+    TP_ARGS(inodeNumber, depth, blocksScanned),
+
+    TP_STRUCT__entry(
+        __field(int, inode)
+        __field(int, depth)
+        __field(int, blocks)
+    ),
+
+    TP_fast_assign(
+        __entry->inode = inodeNumber;
+        __entry->depth = depth;
+        __entry->blocks = blocksScanned;
+    ),
+
+    TP_printk("inode=%d depth=%d blocks=%d",
+              __entry->inode, __entry->depth, __entry->blocks)
+);
+
+// a task got its own descriptor table
+TRACE_EVENT(ramdisk_fd_table,
+
+    TP_PROTO(int pid),
+
+    TP_ARGS(pid),
+
+    TP_STRUCT__entry(
+        __field(int, pid)
+    ),
+
+    TP_fast_assign(
+        __entry->pid = pid;
+    ),
+
+    TP_printk("pid=%d", __entry->pid)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ramdisk_trace
+#include <trace/define_trace.h>
+
+#else
+
+#ifndef RAMDISK_TRACE_H
+#define RAMDISK_TRACE_H
+
+static inline void trace_ramdisk_op_enter(int op, int fd, int inodeNumber, int offset, int length) { }
+static inline void trace_ramdisk_op_exit(int op, int inodeNumber, int result) { }
+static inline int trace_ramdisk_op_enter_enabled(void) { return 0; }
+static inline int trace_ramdisk_op_exit_enabled(void) { return 0; }
+static inline void trace_ramdisk_alloc_block(int block, int count, unsigned int freeBlocks) { }
+static inline void trace_ramdisk_free_block(int block, int count, unsigned int freeBlocks) { }
+static inline void trace_ramdisk_lookup(int inodeNumber, int depth, int blocksScanned) { }
+static inline void trace_ramdisk_fd_table(int pid) { }
+
+#endif
+
+#endif
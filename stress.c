@@ -0,0 +1,668 @@
+/*
+ * stress.c - mixed workload from many processes and threads at once
+ * Forks N processes of M threads; every worker runs a random mix of
+ * operations on one shared working set of files for a fixed time, then
+ * the parent reports the throughput of each worker and of all of them.
+ * Built as stress against the module, or as stress_lib
+ * (-DSTRESS_IN_PROCESS) against libramdisk.a, which runs one process.
+ *
+ * Usage: stress [-p processes] [-t threads] [-d seconds] [-w files]
+ *               [-D depth] [-z theta] [-s min,max] [-b uniform|log]
+ *               [-m op:weight,...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#ifdef STRESS_IN_PROCESS
+#include "ramdisk.h"
+
+#define CREAT(path)                 ram_creat(path)
+#define MKDIR(path)                 ram_mkdir(path)
+#define OPEN(path)                  ram_open(path)
+#define CLOSE(fd)                   ram_close(fd)
+#define READ(fd, address, n)        ram_read(fd, address, n)
+#define WRITE(fd, address, n)       ram_write(fd, address, n)
+#define READDIR(fd, address)        ram_readdir(fd, address)
+#define UNLINK(path)                ram_unlink(path)
+
+#else
+#include "ramdisk_ioctl.h"
+
+static int deviceFd;
+
+#define CREAT(path)                 rd_creat(deviceFd, path)
+#define MKDIR(path)                 rd_mkdir(deviceFd, path)
+#define OPEN(path)                  rd_open(deviceFd, path)
+#define CLOSE(fd)                   rd_close(deviceFd, fd)
+#define READ(fd, address, n)        rd_read(deviceFd, fd, address, n)
+#define WRITE(fd, address, n)       rd_write(deviceFd, fd, address, n)
+#define READDIR(fd, address)        rd_readdir(deviceFd, fd, address)
+#define UNLINK(path)                rd_unlink(deviceFd, path)
+
+#endif
+
+#define STRESS_PATH_MAX 128
+#define STRESS_GROUPS 8
+#define STRESS_MAX_FILE (128 * 1024)
+#define STRESS_CHUNK 4096
+
+// the operations in the mix
+enum {
+    OP_READ,        // open, read the whole file, close
+    OP_WRITE,       // open, write a new length from the start, close
+    OP_OPEN,        // open and close
+    OP_CREAT,       // unlink and create again with a new length
+    OP_UNLINK,      // later operations on the file fail until a creat
+    OP_READDIR,     // list the directory holding the file
+    OP_COUNT
+};
+
+static char* opNames[OP_COUNT] = {
+    "read", "write", "open", "creat", "unlink", "readdir"
+};
+
+typedef struct {
+    long count[OP_COUNT];
+    long failed[OP_COUNT];
+    long bytes;
+    double seconds;
+} workerStats;
+
+typedef struct {
+    int processes;
+    int threads;
+    int seconds;
+    int files;
+    int depth;
+    double theta;
+    int minSize;
+    int maxSize;
+    int logSizes;
+    int weights[OP_COUNT];
+    int totalWeight;
+
+    //Zipfian constants, see nextZipf
+    double zetan;
+    double alpha;
+    double eta;
+} stressConfig;
+
+typedef struct {
+    stressConfig* config;
+    workerStats* stats;
+    long deadline;
+    int process;
+    int thread;
+    unsigned long random;
+    char* buffer;
+} stressWorker;
+
+static long nowNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static unsigned long nextRandom(stressWorker* worker)
+{
+    //xorshift64*
+    worker->random ^= worker->random >> 12;
+    worker->random ^= worker->random << 25;
+    worker->random ^= worker->random >> 27;
+    return worker->random * 2685821657736338717UL;
+}
+
+// uniform in [0, 1)
+static double nextUniform(stressWorker* worker)
+{
+    return (nextRandom(worker) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void setupZipf(stressConfig* config)
+{
+    double zeta2;
+    int i;
+
+    config->zetan = 0;
+    for (i = 1; i <= config->files; i++)
+    {
+        config->zetan += 1 / pow(i, config->theta);
+    }
+    zeta2 = 1 + 1 / pow(2, config->theta);
+    config->alpha = 1 / (1 - config->theta);
+    config->eta = (1 - pow(2.0 / config->files, 1 - config->theta)) / (1 - zeta2 / config->zetan);
+}
+
+// a rank drawn with probability falling as 1/rank^theta (Gray et al.,
+// "Quickly generating billion-record synthetic databases"), spread over
+// the working set so the hot files do not share a directory
+static int nextZipf(stressWorker* worker)
+{
+    stressConfig* config = worker->config;
+    double u, uz;
+    long rank;
+
+    u = nextUniform(worker);
+    uz = u * config->zetan;
+    if (uz < 1)
+    {
+        rank = 0;
+    }
+    else if (uz < 1 + pow(0.5, config->theta))
+    {
+        rank = 1;
+    }
+    else
+    {
+        rank = (long) (config->files * pow(config->eta * u - config->eta + 1, config->alpha));
+    }
+    if (rank >= config->files)
+    {
+        rank = config->files - 1;
+    }
+    return (int) (rank * 7919 % config->files);
+}
+
+static int nextSize(stressWorker* worker)
+{
+    stressConfig* config = worker->config;
+    double u;
+
+    u = nextUniform(worker);
+    if (config->logSizes)
+    {
+        return (int) exp(log(config->minSize) + u * (log(config->maxSize) - log(config->minSize)));
+    }
+    return config->minSize + (int) (u * (config->maxSize - config->minSize + 1));
+}
+
+static int nextOp(stressWorker* worker)
+{
+    stressConfig* config = worker->config;
+    int pick, op;
+
+    pick = nextRandom(worker) % config->totalWeight;
+    for (op = 0; pick >= config->weights[op]; op++)
+    {
+        pick -= config->weights[op];
+    }
+    return op;
+}
+
+// file k lives depth directories down in group k % STRESS_GROUPS:
+// /w/g<group>/n/.../f<k>
+static void dirPath(stressConfig* config, int file, int levels, char* path)
+{
+    int length, level;
+
+    length = sprintf(path, "/w");
+    if (levels > 0)
+    {
+        length += sprintf(path + length, "/g%d", file % STRESS_GROUPS);
+    }
+    for (level = 1; level < levels; level++)
+    {
+        length += sprintf(path + length, "/n");
+    }
+}
+
+static void filePath(stressConfig* config, int file, char* path)
+{
+    dirPath(config, file, config->depth, path);
+    sprintf(path + strlen(path), "/f%d", file);
+}
+
+// writes length bytes from the start of an open file
+static int fillFile(stressWorker* worker, int fd, int length)
+{
+    int chunk, written;
+
+    for (written = 0; written < length; written += chunk)
+    {
+        chunk = length - written < STRESS_CHUNK ? length - written : STRESS_CHUNK;
+        if (WRITE(fd, worker->buffer, chunk) != chunk)
+        {
+            return -1;
+        }
+    }
+    worker->stats->bytes += length;
+    return 0;
+}
+
+static int runOp(stressWorker* worker, int op, int file)
+{
+    char path[STRESS_PATH_MAX];
+    char entry[64];
+    int fd, ret, chunk;
+
+    filePath(worker->config, file, path);
+    switch (op)
+    {
+        case OP_READ:
+            fd = OPEN(path);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            while ((chunk = READ(fd, worker->buffer, STRESS_CHUNK)) > 0)
+            {
+                worker->stats->bytes += chunk;
+            }
+            CLOSE(fd);
+            return chunk;
+
+        case OP_WRITE:
+            fd = OPEN(path);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            ret = fillFile(worker, fd, nextSize(worker));
+            CLOSE(fd);
+            return ret;
+
+        case OP_OPEN:
+            fd = OPEN(path);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            return CLOSE(fd);
+
+        case OP_CREAT:
+            UNLINK(path);
+            if (CREAT(path) < 0)
+            {
+                return -1;
+            }
+            fd = OPEN(path);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            ret = fillFile(worker, fd, nextSize(worker));
+            CLOSE(fd);
+            return ret;
+
+        case OP_UNLINK:
+            return UNLINK(path);
+
+        case OP_READDIR:
+            dirPath(worker->config, file, worker->config->depth, path);
+            fd = OPEN(path);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            while ((ret = READDIR(fd, entry)) > 0)
+            {
+            }
+            CLOSE(fd);
+            return ret;
+    }
+    return -1;
+}
+
+static void* runWorker(void* arg)
+{
+    stressWorker* worker = (stressWorker*) arg;
+    long started;
+    int op;
+
+    started = nowNs();
+    while (nowNs() < worker->deadline)
+    {
+        op = nextOp(worker);
+        if (runOp(worker, op, nextZipf(worker)) < 0)
+        {
+            worker->stats->failed[op]++;
+        }
+        worker->stats->count[op]++;
+    }
+    worker->stats->seconds = (nowNs() - started) / 1e9;
+    return NULL;
+}
+
+// one process: its threads write their counts into its slice of the
+// shared stats
+static void runProcess(stressConfig* config, workerStats* stats, int process, long deadline)
+{
+    stressWorker* workers;
+    pthread_t* ids;
+    int t;
+
+    workers = (stressWorker*) calloc(config->threads, sizeof(stressWorker));
+    ids = (pthread_t*) calloc(config->threads, sizeof(pthread_t));
+    for (t = 0; t < config->threads; t++)
+    {
+        workers[t].config = config;
+        workers[t].stats = &stats[process * config->threads + t];
+        workers[t].deadline = deadline;
+        workers[t].process = process;
+        workers[t].thread = t;
+        workers[t].random = 0x9E3779B97F4A7C15UL * (process * config->threads + t + 1);
+        workers[t].buffer = (char*) malloc(STRESS_MAX_FILE);
+        memset(workers[t].buffer, 'a' + t % 26, STRESS_MAX_FILE);
+        pthread_create(&ids[t], NULL, runWorker, &workers[t]);
+    }
+    for (t = 0; t < config->threads; t++)
+    {
+        pthread_join(ids[t], NULL);
+        free(workers[t].buffer);
+    }
+    free(workers);
+    free(ids);
+}
+
+// builds the tree and every file at a length from the distribution
+static int setupWorkingSet(stressConfig* config)
+{
+    stressWorker setup;
+    char path[STRESS_PATH_MAX];
+    workerStats stats;
+    int file, level, fd;
+
+    memset(&setup, 0, sizeof(stressWorker));
+    memset(&stats, 0, sizeof(workerStats));
+    setup.config = config;
+    setup.stats = &stats;
+    setup.random = 88172645463325252UL;
+    setup.buffer = (char*) malloc(STRESS_MAX_FILE);
+    memset(setup.buffer, 's', STRESS_MAX_FILE);
+
+    MKDIR("/w");
+    for (file = 0; file < STRESS_GROUPS && file < config->files; file++)
+    {
+        for (level = 1; level <= config->depth; level++)
+        {
+            dirPath(config, file, level, path);
+            MKDIR(path);
+        }
+    }
+    for (file = 0; file < config->files; file++)
+    {
+        filePath(config, file, path);
+        fd = -1;
+        if (CREAT(path) >= 0)
+        {
+            fd = OPEN(path);
+        }
+        if (fd < 0 || fillFile(&setup, fd, nextSize(&setup)) < 0)
+        {
+            fprintf(stderr, "stress: cannot set up %s\n", path);
+            free(setup.buffer);
+            return -1;
+        }
+        CLOSE(fd);
+    }
+    free(setup.buffer);
+    return 0;
+}
+
+static void teardownWorkingSet(stressConfig* config)
+{
+    char path[STRESS_PATH_MAX];
+    int file, level;
+
+    for (file = 0; file < config->files; file++)
+    {
+        filePath(config, file, path);
+        UNLINK(path);
+    }
+    for (file = 0; file < STRESS_GROUPS && file < config->files; file++)
+    {
+        for (level = config->depth; level >= 1; level--)
+        {
+            dirPath(config, file, level, path);
+            UNLINK(path);
+        }
+    }
+    UNLINK("/w");
+}
+
+static void printStats(char* worker, workerStats* stats, double seconds)
+{
+    long total, failed;
+    int op;
+
+    total = failed = 0;
+    for (op = 0; op < OP_COUNT; op++)
+    {
+        printf("%s,%s,%ld,%ld,%.0f\n", worker, opNames[op], stats->count[op], stats->failed[op],
+               seconds > 0 ? stats->count[op] / seconds : 0);
+        total += stats->count[op];
+        failed += stats->failed[op];
+    }
+    printf("%s,all,%ld,%ld,%.0f\n", worker, total, failed, seconds > 0 ? total / seconds : 0);
+    printf("%s,bytes,%ld,0,%.0f\n", worker, stats->bytes, seconds > 0 ? stats->bytes / seconds : 0);
+}
+
+// per worker, then summed over all of them; the aggregate rate is over the
+// longest any worker ran
+static void report(stressConfig* config, workerStats* stats)
+{
+    workerStats total;
+    char name[32];
+    double longest;
+    int worker, op;
+
+    memset(&total, 0, sizeof(workerStats));
+    longest = 0;
+    printf("worker,op,count,failed,ops_per_sec\n");
+    for (worker = 0; worker < config->processes * config->threads; worker++)
+    {
+        sprintf(name, "p%dt%d", worker / config->threads, worker % config->threads);
+        printStats(name, &stats[worker], stats[worker].seconds);
+        for (op = 0; op < OP_COUNT; op++)
+        {
+            total.count[op] += stats[worker].count[op];
+            total.failed[op] += stats[worker].failed[op];
+        }
+        total.bytes += stats[worker].bytes;
+        if (stats[worker].seconds > longest)
+        {
+            longest = stats[worker].seconds;
+        }
+    }
+    printStats("total", &total, longest);
+}
+
+// parses op:weight pairs; operations left out get no weight
+static int parseMix(stressConfig* config, char* text)
+{
+    char* token;
+    char* colon;
+    int op;
+
+    memset(config->weights, 0, sizeof(config->weights));
+    for (token = strtok(text, ","); token; token = strtok(NULL, ","))
+    {
+        colon = strchr(token, ':');
+        if (!colon)
+        {
+            return -1;
+        }
+        *colon = '\0';
+        for (op = 0; op < OP_COUNT && strcmp(opNames[op], token) != 0; op++)
+        {
+        }
+        if (op == OP_COUNT || atoi(colon + 1) < 0)
+        {
+            return -1;
+        }
+        config->weights[op] = atoi(colon + 1);
+    }
+    return 0;
+}
+
+static void usage(char* name)
+{
+    fprintf(stderr, "usage: %s [-p processes] [-t threads] [-d seconds] [-w files] [-D depth] "
+            "[-z theta] [-s min,max] [-b uniform|log] [-m op:weight,...]\n"
+            "ops: read write open creat unlink readdir\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+    stressConfig config;
+    workerStats* stats;
+    char defaultMix[] = "read:50,write:20,open:10,creat:8,unlink:2,readdir:10";
+    char* mix;
+    long deadline;
+    int option, process, op;
+    pid_t pid;
+
+    memset(&config, 0, sizeof(stressConfig));
+    config.processes = 2;
+    config.threads = 4;
+    config.seconds = 10;
+    config.files = 256;
+    config.depth = 3;
+    config.theta = 0.99;
+    config.minSize = 64;
+    config.maxSize = 8192;
+    config.logSizes = 1;
+    mix = defaultMix;
+
+    while ((option = getopt(argc, argv, "p:t:d:w:D:z:s:b:m:")) != -1)
+    {
+        switch (option)
+        {
+            case 'p':
+                config.processes = atoi(optarg);
+                break;
+            case 't':
+                config.threads = atoi(optarg);
+                break;
+            case 'd':
+                config.seconds = atoi(optarg);
+                break;
+            case 'w':
+                config.files = atoi(optarg);
+                break;
+            case 'D':
+                config.depth = atoi(optarg);
+                break;
+            case 'z':
+                config.theta = atof(optarg);
+                break;
+            case 's':
+                if (sscanf(optarg, "%d,%d", &config.minSize, &config.maxSize) != 2)
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b':
+                config.logSizes = strcmp(optarg, "log") == 0;
+                break;
+            case 'm':
+                mix = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (parseMix(&config, mix) == -1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    for (op = 0; op < OP_COUNT; op++)
+    {
+        config.totalWeight += config.weights[op];
+    }
+    if (config.processes < 1 || config.threads < 1 || config.seconds < 1 || config.files < 2 ||
+        config.depth < 0 || config.depth > 40 || config.theta < 0 || config.theta >= 1 ||
+        config.minSize < 1 || config.maxSize < config.minSize || config.maxSize > STRESS_MAX_FILE ||
+        config.totalWeight == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    setupZipf(&config);
+
+#ifdef STRESS_IN_PROCESS
+    if (config.processes != 1)
+    {
+        fprintf(stderr, "stress: the in-process ramdisk is not shared, use -p 1\n");
+        return 1;
+    }
+    if (initRamdisk() < 0)
+    {
+        fprintf(stderr, "stress: cannot set up the ramdisk\n");
+        return 1;
+    }
+#else
+    deviceFd = open(DEVICE_PATH, O_RDWR);
+    if (deviceFd < 0)
+    {
+        perror("stress: " DEVICE_PATH);
+        return 1;
+    }
+#endif
+
+    if (setupWorkingSet(&config) == -1)
+    {
+        teardownWorkingSet(&config);
+        return 1;
+    }
+
+    //children fill their slices of a shared mapping and the parent reads
+    //them after every child has exited
+    stats = (workerStats*) mmap(NULL, sizeof(workerStats) * config.processes * config.threads,
+                                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED)
+    {
+        perror("stress: mmap");
+        return 1;
+    }
+
+    deadline = nowNs() + config.seconds * 1000000000L;
+    if (config.processes == 1)
+    {
+        runProcess(&config, stats, 0, deadline);
+    }
+    else
+    {
+        for (process = 0; process < config.processes; process++)
+        {
+            pid = fork();
+            if (pid == 0)
+            {
+                runProcess(&config, stats, process, deadline);
+                _exit(0);
+            }
+            if (pid < 0)
+            {
+                perror("stress: fork");
+            }
+        }
+        while (wait(NULL) > 0)
+        {
+        }
+    }
+
+    report(&config, stats);
+    teardownWorkingSet(&config);
+    munmap(stats, sizeof(workerStats) * config.processes * config.threads);
+
+#ifdef STRESS_IN_PROCESS
+    destroyRamdisk();
+#else
+    close(deviceFd);
+#endif
+    return 0;
+}
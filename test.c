@@ -18,6 +18,9 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
 
 #include "ramdisk_ioctl.h" 
 
@@ -30,6 +33,16 @@
 //#define TEST3
 //#define TEST4
 //#define TEST5
+#define TEST6
+#define TEST7
+#define TEST8
+#define TEST9
+#define TEST10
+#define TEST11
+#define TEST12
+#define TEST13
+#define TEST14
+#define TEST15
 
 // Insert a string for the pathname prefix here. For the ramdisk, it should be
 // NULL
@@ -95,7 +108,7 @@ int main () {
   int index_node_number;
   int fd1;
 
-  fd1 = open(DEVICE_PATH, O_RDONLY);
+  fd1 = open(DEVICE_PATH, O_RDWR);
   if (fd1 < 0) {
         printf("Failed to open ramdisk.\n");
         return -1;
@@ -412,6 +425,1075 @@ for (i = 0; i < MAX_FILES; i++) {
 
 #endif // TEST5
 
+#ifdef TEST6
+#ifdef USE_RAMDISK
+
+  /* ****TEST 6: Positional read and write**** */
+  retval = CREAT (fd1, PATH_PREFIX "/posfile");
+  fd = OPEN (fd1, PATH_PREFIX "/posfile");
+
+  if (retval < 0 || fd < 0) {
+    fprintf (stderr, "open: /posfile open error! status: %d\n",
+	     fd);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pwrite (fd1, fd, data1, sizeof(data1), 0);
+
+  if (retval != sizeof(data1)) {
+    fprintf (stderr, "pwrite: File write error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Appending at the end crosses into the indirect blocks */
+  retval = rd_pwrite (fd1, fd, data2, sizeof(data2), sizeof(data1));
+
+  if (retval != sizeof(data2)) {
+    fprintf (stderr, "pwrite: File append error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Files have no holes, and offsets are never negative */
+  retval = rd_pwrite (fd1, fd, data1, 1, sizeof(data1) + sizeof(data2) + 1);
+
+  if (retval >= 0) {
+    fprintf (stderr, "pwrite: Wrote past the end! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pwrite (fd1, fd, data1, 1, -1);
+
+  if (retval >= 0) {
+    fprintf (stderr, "pwrite: Wrote at a negative offset! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  memset (addr, 0, sizeof(addr));
+  retval = rd_pread (fd1, fd, addr, 20, sizeof(data1) - 10);
+
+  if (retval != 20 || memcmp (addr, data1, 10) || memcmp (addr + 10, data2, 10)) {
+    fprintf (stderr, "pread: File read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* A read across the end stops there, one at or past it reads nothing */
+  retval = rd_pread (fd1, fd, addr, 100, sizeof(data1) + sizeof(data2) - 10);
+
+  if (retval != 10) {
+    fprintf (stderr, "pread: Short read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pread (fd1, fd, addr, 100, sizeof(data1) + sizeof(data2) + 100);
+
+  if (retval != 0) {
+    fprintf (stderr, "pread: Read past the end! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pread (fd1, fd, addr, 100, -1);
+
+  if (retval >= 0) {
+    fprintf (stderr, "pread: Read at a negative offset! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Neither moved the file position */
+  retval = READ (fd1, fd, addr, 10);
+
+  if (retval != 10 || memcmp (addr, data1, 10)) {
+    fprintf (stderr, "read: Position moved by pread/pwrite! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pread (fd1, MAX_FILES, addr, 10, 0);
+
+  if (retval >= 0) {
+    fprintf (stderr, "pread: Read through a closed descriptor! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  CLOSE (fd1, fd);
+  retval = UNLINK (fd1, PATH_PREFIX "/posfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /posfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+#endif // USE_RAMDISK
+#endif // TEST6
+
+#ifdef TEST7
+#ifdef USE_RAMDISK
+  {
+  /* ****TEST 7: Vectored read and write**** */
+  rd_iovec iov[RD_IOV_MAX + 1];
+
+  retval = CREAT (fd1, PATH_PREFIX "/vecfile");
+  fd = OPEN (fd1, PATH_PREFIX "/vecfile");
+
+  if (retval < 0 || fd < 0) {
+    fprintf (stderr, "open: /vecfile open error! status: %d\n",
+	     fd);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Gathered in order into one write */
+  iov[0].address = data1;
+  iov[0].num_bytes = 100;
+  iov[1].address = data2;
+  iov[1].num_bytes = 0;
+  iov[2].address = data3;
+  iov[2].num_bytes = 3000;
+  retval = rd_writev (fd1, fd, iov, 3);
+
+  if (retval != 3100) {
+    fprintf (stderr, "writev: File write error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Scattered back, the last buffer only partly filled at the end */
+  LSEEK (fd1, fd, 0);
+  memset (addr, 0, sizeof(addr));
+  iov[0].address = addr;
+  iov[0].num_bytes = 50;
+  iov[1].address = addr + 1000;
+  iov[1].num_bytes = 50;
+  iov[2].address = addr + 2000;
+  iov[2].num_bytes = 5000;
+  retval = rd_readv (fd1, fd, iov, 3);
+
+  if (retval != 3100 || memcmp (addr, data1, 50) || memcmp (addr + 1000, data1, 50) ||
+      memcmp (addr + 2000, data3, 3000) || addr[5000] != 0) {
+    fprintf (stderr, "readv: File read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* At the end of the file there is nothing left */
+  retval = rd_readv (fd1, fd, iov, 3);
+
+  if (retval != 0) {
+    fprintf (stderr, "readv: Read past the end! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Bad vectors fail without touching the file */
+  retval = rd_writev (fd1, fd, iov, 0);
+
+  if (retval >= 0) {
+    fprintf (stderr, "writev: Empty vector accepted! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_writev (fd1, fd, iov, RD_IOV_MAX + 1);
+
+  if (retval >= 0) {
+    fprintf (stderr, "writev: Oversized vector accepted! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  iov[0].address = (char*) 8;
+  iov[0].num_bytes = 10;
+  retval = rd_writev (fd1, fd, iov, 1);
+
+  if (retval >= 0) {
+    fprintf (stderr, "writev: Faulting buffer accepted! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pread (fd1, fd, addr, sizeof(addr), 0);
+
+  if (retval != 3100) {
+    fprintf (stderr, "writev: File changed by a failed writev! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  CLOSE (fd1, fd);
+  retval = UNLINK (fd1, PATH_PREFIX "/vecfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /vecfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+  }
+#endif // USE_RAMDISK
+#endif // TEST7
+
+#ifdef TEST8
+#ifdef USE_RAMDISK
+  {
+  /* ****TEST 8: Submission/completion ring**** */
+  rd_ring* ring;
+  rd_sqe* sqe;
+  rd_cqe* cqe;
+
+  ring = rd_ring_setup (fd1);
+
+  if (ring == NULL) {
+    fprintf (stderr, "ring: Ring setup error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Nothing queued, nothing runs */
+  retval = rd_ring_enter (fd1, RD_RING_ENTRIES);
+
+  if (retval != 0 || rd_ring_peek_cqe (ring) != NULL) {
+    fprintf (stderr, "ring: Empty ring ran! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  sqe = rd_ring_next_sqe (ring);
+  rd_prep_path (sqe, IOCTL_RD_CREAT, PATH_PREFIX "/ringfile");
+  sqe->userData = 1;
+  rd_ring_push (ring);
+  sqe = rd_ring_next_sqe (ring);
+  rd_prep_path (sqe, IOCTL_RD_OPEN, PATH_PREFIX "/ringfile");
+  sqe->userData = 2;
+  rd_ring_push (ring);
+
+  retval = rd_ring_enter (fd1, RD_RING_ENTRIES);
+
+  if (retval != 2) {
+    fprintf (stderr, "ring: Submission error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  cqe = rd_ring_peek_cqe (ring);
+
+  if (cqe == NULL || cqe->userData != 1 || cqe->ret < 0) {
+    fprintf (stderr, "ring: creat completion error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  rd_ring_cqe_seen (ring);
+  cqe = rd_ring_peek_cqe (ring);
+
+  if (cqe == NULL || cqe->userData != 2 || cqe->ret < 0) {
+    fprintf (stderr, "ring: open completion error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  fd = cqe->ret;
+  rd_ring_cqe_seen (ring);
+
+  /* Entries run in order, so the read sees the write */
+  memset (addr, 0, sizeof(addr));
+  sqe = rd_ring_next_sqe (ring);
+  rd_prep_rw (sqe, IOCTL_RD_PWRITE, fd, data1, sizeof(data1), 0);
+  rd_ring_push (ring);
+  sqe = rd_ring_next_sqe (ring);
+  rd_prep_rw (sqe, IOCTL_RD_PREAD, fd, addr, sizeof(data1), 0);
+  rd_ring_push (ring);
+  sqe = rd_ring_next_sqe (ring);
+  rd_prep_rw (sqe, IOCTL_RD_PREAD, fd, addr, 10, sizeof(data1));
+  rd_ring_push (ring);
+  sqe = rd_ring_next_sqe (ring);
+  rd_prep_fd (sqe, IOCTL_RD_CLOSE, fd);
+  rd_ring_push (ring);
+
+  /* Only as many as asked for run */
+  retval = rd_ring_enter (fd1, 1);
+
+  if (retval != 1) {
+    fprintf (stderr, "ring: Partial submission error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_ring_enter (fd1, RD_RING_ENTRIES);
+
+  if (retval != 3) {
+    fprintf (stderr, "ring: Submission error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  for (i = 0; i < 4; i++) {
+    cqe = rd_ring_peek_cqe (ring);
+
+    if (cqe == NULL) {
+      fprintf (stderr, "ring: Missing completion %d!\n", i);
+
+      exit(EXIT_FAILURE);
+    }
+
+    retval = cqe->ret;
+    rd_ring_cqe_seen (ring);
+
+    /* pwrite, pread, pread at the end of the file, close */
+    if ((i < 2 && retval != sizeof(data1)) || (i >= 2 && retval != 0)) {
+      fprintf (stderr, "ring: Completion %d error! status: %d\n",
+	       i, retval);
+
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (memcmp (addr, data1, sizeof(data1)) || rd_ring_peek_cqe (ring) != NULL) {
+    fprintf (stderr, "ring: Read back error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = UNLINK (fd1, PATH_PREFIX "/ringfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /ringfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+  }
+#endif // USE_RAMDISK
+#endif // TEST8
+
+#ifdef TEST9
+#ifdef USE_RAMDISK
+
+  /* ****TEST 9: Whole-file read and replace**** */
+  retval = rd_writefile (fd1, PATH_PREFIX "/wholefile", data1, sizeof(data1));
+
+  if (retval != sizeof(data1)) {
+    fprintf (stderr, "writefile: File creation error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  memset (addr, 0, sizeof(addr));
+  retval = rd_readfile (fd1, PATH_PREFIX "/wholefile", addr, sizeof(data1));
+
+  if (retval != sizeof(data1) || memcmp (addr, data1, sizeof(data1))) {
+    fprintf (stderr, "readfile: File read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* A short buffer still learns the whole size */
+  memset (addr, 0, sizeof(addr));
+  retval = rd_readfile (fd1, PATH_PREFIX "/wholefile", addr, 10);
+
+  if (retval != sizeof(data1) || addr[10] != 0) {
+    fprintf (stderr, "readfile: Short read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_readfile (fd1, PATH_PREFIX "/nofile", addr, 10);
+
+  if (retval >= 0) {
+    fprintf (stderr, "readfile: Missing file read! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* A descriptor left on the old contents goes stale */
+  fd = OPEN (fd1, PATH_PREFIX "/wholefile");
+  retval = READ (fd1, fd, addr, 100);
+
+  if (retval != 100) {
+    fprintf (stderr, "read: File read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_writefile (fd1, PATH_PREFIX "/wholefile", data2, 50);
+
+  if (retval != 50) {
+    fprintf (stderr, "writefile: File replace error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = READ (fd1, fd, addr, 10);
+
+  if (retval >= 0) {
+    fprintf (stderr, "read: Read through a replaced file! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  CLOSE (fd1, fd);
+
+  memset (addr, 0, sizeof(addr));
+  retval = rd_readfile (fd1, PATH_PREFIX "/wholefile", addr, sizeof(data1));
+
+  if (retval != 50 || memcmp (addr, data2, 50) || addr[50] != 0) {
+    fprintf (stderr, "readfile: Replaced file read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* A file open as a struct file is not replaced */
+  fd = rd_openfile (fd1, PATH_PREFIX "/wholefile");
+
+  if (fd < 0) {
+    fprintf (stderr, "openfile: File open error! status: %d\n",
+	     fd);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_writefile (fd1, PATH_PREFIX "/wholefile", data1, 10);
+
+  if (retval >= 0) {
+    fprintf (stderr, "writefile: Replaced an open file! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  close (fd);
+
+  retval = UNLINK (fd1, PATH_PREFIX "/wholefile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /wholefile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+#endif // USE_RAMDISK
+#endif // TEST9
+
+#ifdef TEST10
+#ifdef USE_RAMDISK
+
+  /* ****TEST 10: Ramdisk files as real file descriptors**** */
+  retval = rd_openfile (fd1, PATH_PREFIX "/nofile");
+
+  if (retval >= 0) {
+    fprintf (stderr, "openfile: Opened a missing file! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_openfile (fd1, PATH_PREFIX "/");
+
+  if (retval >= 0) {
+    fprintf (stderr, "openfile: Opened a directory! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  rd_writefile (fd1, PATH_PREFIX "/realfile", data1, sizeof(data1));
+  fd = rd_openfile (fd1, PATH_PREFIX "/realfile");
+
+  if (fd < 0) {
+    fprintf (stderr, "openfile: File open error! status: %d\n",
+	     fd);
+
+    exit(EXIT_FAILURE);
+  }
+
+  memset (addr, 0, sizeof(addr));
+  retval = read (fd, addr, sizeof(data2));
+
+  if (retval != sizeof(data1) || memcmp (addr, data1, sizeof(data1))) {
+    fprintf (stderr, "openfile: read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = read (fd, addr, sizeof(data2));
+
+  if (retval != 0) {
+    fprintf (stderr, "openfile: read past the end! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Files have no holes, so seeks and writes stop at the end */
+  if (lseek (fd, 0, SEEK_END) != sizeof(data1) || lseek (fd, 1, SEEK_END) >= 0) {
+    fprintf (stderr, "openfile: lseek error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = pwrite (fd, data2, 100, sizeof(data1));
+
+  if (retval != 100) {
+    fprintf (stderr, "openfile: pwrite error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = pwrite (fd, data2, 100, sizeof(data1) + 200);
+
+  if (retval >= 0) {
+    fprintf (stderr, "openfile: pwrite past the end! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_readfile (fd1, PATH_PREFIX "/realfile", addr, sizeof(addr));
+
+  if (retval != sizeof(data1) + 100 || memcmp (addr + sizeof(data1), data2, 100)) {
+    fprintf (stderr, "openfile: Write not seen by readfile! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* The open file keeps its name */
+  retval = UNLINK (fd1, PATH_PREFIX "/realfile");
+
+  if (retval >= 0) {
+    fprintf (stderr, "unlink: Unlinked an open file! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  close (fd);
+  retval = UNLINK (fd1, PATH_PREFIX "/realfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /realfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+#endif // USE_RAMDISK
+#endif // TEST10
+
+#ifdef TEST11
+#ifdef USE_RAMDISK
+  {
+  /* ****TEST 11: Sending a file to another file**** */
+  FILE* outFile;
+  int outFd;
+
+  /* Several chunks of the kernel's bounce buffer */
+  rd_writefile (fd1, PATH_PREFIX "/sendfile", data3, 200000);
+  fd = OPEN (fd1, PATH_PREFIX "/sendfile");
+  outFile = tmpfile ();
+
+  if (fd < 0 || outFile == NULL) {
+    fprintf (stderr, "sendfile: Setup error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  outFd = fileno (outFile);
+  retval = rd_sendfile (fd1, outFd, fd, 300000);
+
+  if (retval != 200000) {
+    fprintf (stderr, "sendfile: Send error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  memset (addr, 0, sizeof(addr));
+  retval = pread (outFd, addr, sizeof(addr), 0);
+
+  if (retval != 200000 || memcmp (addr, data3, 200000)) {
+    fprintf (stderr, "sendfile: Sent data error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* The descriptor moved to the end, so there is nothing left */
+  retval = rd_sendfile (fd1, outFd, fd, 100);
+
+  if (retval != 0) {
+    fprintf (stderr, "sendfile: Sent past the end! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_sendfile (fd1, -1, fd, 100);
+
+  if (retval >= 0) {
+    fprintf (stderr, "sendfile: Sent to a bad descriptor! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Another ramdisk file can be the target */
+  rd_writefile (fd1, PATH_PREFIX "/sendcopy", data1, 0);
+  outFd = rd_openfile (fd1, PATH_PREFIX "/sendcopy");
+  LSEEK (fd1, fd, 100);
+  retval = rd_sendfile (fd1, outFd, fd, 1000);
+
+  if (retval != 1000) {
+    fprintf (stderr, "sendfile: Send to a ramdisk file error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  close (outFd);
+  retval = rd_readfile (fd1, PATH_PREFIX "/sendcopy", addr, sizeof(addr));
+
+  if (retval != 1000 || memcmp (addr, data3 + 100, 1000)) {
+    fprintf (stderr, "sendfile: Ramdisk copy error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  fclose (outFile);
+  CLOSE (fd1, fd);
+  UNLINK (fd1, PATH_PREFIX "/sendcopy");
+  retval = UNLINK (fd1, PATH_PREFIX "/sendfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /sendfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+  }
+#endif // USE_RAMDISK
+#endif // TEST11
+
+#ifdef TEST12
+#ifdef USE_RAMDISK
+  {
+  /* ****TEST 12: Asynchronous requests**** */
+  rd_sqe sqe;
+  rd_cqe cqes[3];
+  uint64_t events;
+  int efd, done;
+
+  efd = eventfd (0, 0);
+  retval = rd_aio_setup (fd1, efd);
+
+  if (efd < 0 || retval < 0) {
+    fprintf (stderr, "aio: Context setup error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Nothing submitted, nothing to reap */
+  retval = rd_aio_reap (fd1, cqes, 3);
+
+  if (retval != 0) {
+    fprintf (stderr, "aio: Reaped from an idle context! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = CREAT (fd1, PATH_PREFIX "/aiofile");
+  fd = OPEN (fd1, PATH_PREFIX "/aiofile");
+
+  rd_prep_rw (&sqe, IOCTL_RD_PWRITE, fd, data1, sizeof(data1), 0);
+  sqe.userData = 1;
+  retval = rd_aio_submit (fd1, &sqe);
+
+  if (retval < 0) {
+    fprintf (stderr, "aio: pwrite submission error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Every completion signals the eventfd */
+  read (efd, &events, sizeof(events));
+  retval = rd_aio_reap (fd1, cqes, 3);
+
+  if (retval != 1 || cqes[0].userData != 1 || cqes[0].ret != sizeof(data1)) {
+    fprintf (stderr, "aio: pwrite completion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* A read, a read at the end of the file and a write past it */
+  memset (addr, 0, sizeof(addr));
+  rd_prep_rw (&sqe, IOCTL_RD_PREAD, fd, addr, sizeof(data1), 0);
+  sqe.userData = 2;
+  rd_aio_submit (fd1, &sqe);
+  rd_prep_rw (&sqe, IOCTL_RD_PREAD, fd, addr + sizeof(data1), sizeof(data1), sizeof(data1));
+  sqe.userData = 3;
+  rd_aio_submit (fd1, &sqe);
+  rd_prep_rw (&sqe, IOCTL_RD_PWRITE, fd, data2, 16, sizeof(data1) + 1);
+  sqe.userData = 4;
+  rd_aio_submit (fd1, &sqe);
+
+  /* Completions arrive in any order */
+  for (done = 0; done < 3; done += retval) {
+    read (efd, &events, sizeof(events));
+    retval = rd_aio_reap (fd1, cqes + done, 3 - done);
+
+    if (retval < 0) {
+      fprintf (stderr, "aio: Reap error! status: %d\n",
+	       retval);
+
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (i = 0; i < 3; i++) {
+    if ((cqes[i].userData == 2 && cqes[i].ret != sizeof(data1)) ||
+	(cqes[i].userData == 3 && cqes[i].ret != 0) ||
+	(cqes[i].userData == 4 && cqes[i].ret >= 0)) {
+      fprintf (stderr, "aio: Request %llu completion error! status: %d\n",
+	       cqes[i].userData, cqes[i].ret);
+
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (memcmp (addr, data1, sizeof(data1))) {
+    fprintf (stderr, "aio: pread data error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Bad descriptors are refused at submission */
+  rd_prep_rw (&sqe, IOCTL_RD_PREAD, -1, addr, 16, 0);
+  retval = rd_aio_submit (fd1, &sqe);
+
+  if (retval >= 0) {
+    fprintf (stderr, "aio: Bad descriptor accepted! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  CLOSE (fd1, fd);
+
+  rd_prep_path (&sqe, IOCTL_RD_UNLINK, PATH_PREFIX "/aiofile");
+  sqe.userData = 5;
+  rd_aio_submit (fd1, &sqe);
+  read (efd, &events, sizeof(events));
+  retval = rd_aio_reap (fd1, cqes, 3);
+
+  if (retval != 1 || cqes[0].userData != 5 || cqes[0].ret < 0) {
+    fprintf (stderr, "aio: /aiofile file deletion error! status: %d\n",
+	     cqes[0].ret);
+
+    exit(EXIT_FAILURE);
+  }
+
+  close (efd);
+  }
+#endif // USE_RAMDISK
+#endif // TEST12
+
+#ifdef TEST13
+#ifdef USE_RAMDISK
+
+  /* ****TEST 13: Freezing and thawing**** */
+  retval = rd_writefile (fd1, PATH_PREFIX "/frozenfile", data1, sizeof(data1));
+  fd = OPEN (fd1, PATH_PREFIX "/frozenfile");
+
+  if (retval != sizeof(data1) || fd < 0) {
+    fprintf (stderr, "freeze: File creation error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_freeze (fd1);
+
+  if (retval < 0) {
+    fprintf (stderr, "freeze: Freeze error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_freeze (fd1);
+
+  if (retval >= 0) {
+    fprintf (stderr, "freeze: Froze twice! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Nothing changes while frozen */
+  if (rd_pwrite (fd1, fd, data2, 16, 0) >= 0 ||
+      WRITE (fd1, fd, data2, 16) >= 0 ||
+      CREAT (fd1, PATH_PREFIX "/frozennew") >= 0 ||
+      MKDIR (fd1, PATH_PREFIX "/frozendir") >= 0 ||
+      UNLINK (fd1, PATH_PREFIX "/frozenfile") >= 0 ||
+      rd_writefile (fd1, PATH_PREFIX "/frozenfile", data2, 16) >= 0) {
+    fprintf (stderr, "freeze: Changed a frozen filesystem!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* But reads go on */
+  memset (addr, 0, sizeof(addr));
+  retval = rd_pread (fd1, fd, addr, sizeof(addr), 0);
+
+  if (retval != sizeof(data1) || memcmp (addr, data1, sizeof(data1))) {
+    fprintf (stderr, "freeze: Frozen read error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_thaw (fd1);
+
+  if (retval < 0) {
+    fprintf (stderr, "thaw: Thaw error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_thaw (fd1);
+
+  if (retval >= 0) {
+    fprintf (stderr, "thaw: Thawed twice! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pwrite (fd1, fd, data2, 16, 0);
+
+  if (retval != 16) {
+    fprintf (stderr, "thaw: Write after thaw error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  CLOSE (fd1, fd);
+  retval = UNLINK (fd1, PATH_PREFIX "/frozenfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /frozenfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+#endif // USE_RAMDISK
+#endif // TEST13
+
+#ifdef TEST14
+#ifdef USE_RAMDISK
+
+  /* ****TEST 14: Mapping a file**** */
+  retval = rd_writefile (fd1, PATH_PREFIX "/mapfile", data2, sizeof(data2));
+
+  if (retval != sizeof(data2)) {
+    fprintf (stderr, "writefile: File creation error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  fd = OPEN (fd1, PATH_PREFIX "/mapfile");
+  address = rd_mmap (fd1, fd, sizeof(data2));
+
+  if (address == NULL || memcmp (address, data2, sizeof(data2))) {
+    fprintf (stderr, "mmap: File mapping error!\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* Writes through a descriptor show in the mapping */
+  retval = rd_pwrite (fd1, fd, data1, 16, 0);
+
+  if (retval != 16 || memcmp (address, data1, 16)) {
+    fprintf (stderr, "mmap: Mapping does not follow writes! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* A mapped file, or one selected for mapping, stays linked */
+  retval = UNLINK (fd1, PATH_PREFIX "/mapfile");
+
+  if (retval >= 0) {
+    fprintf (stderr, "unlink: Unlinked a mapped file! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  munmap (address, sizeof(data2));
+  CLOSE (fd1, fd);
+
+  retval = UNLINK (fd1, PATH_PREFIX "/mapfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /mapfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+#endif // USE_RAMDISK
+#endif // TEST14
+
+#ifdef TEST15
+#ifdef USE_RAMDISK
+  {
+  /* ****TEST 15: Backup image**** */
+  rd_image_header header;
+  long total, expected;
+  int bfd;
+
+  retval = rd_writefile (fd1, PATH_PREFIX "/backupfile", data2, sizeof(data2));
+  fd = OPEN (fd1, PATH_PREFIX "/backupfile");
+
+  if (retval != sizeof(data2) || fd < 0) {
+    fprintf (stderr, "backup: File creation error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  bfd = open ("/proc/ramdisk_backup", O_RDONLY);
+  retval = read (bfd, &header, sizeof(header));
+
+  if (bfd < 0 || retval != sizeof(header) ||
+      memcmp (header.magic, RD_IMAGE_MAGIC, sizeof(RD_IMAGE_MAGIC)) ||
+      header.version != RD_IMAGE_VERSION || header.imageInodes < 2 ||
+      header.imageBlocks * header.blockSize < (int) sizeof(data2)) {
+    fprintf (stderr, "backup: Image header error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* The filesystem holds still while the image is open */
+  retval = rd_pwrite (fd1, fd, data1, 16, 0);
+
+  if (retval >= 0) {
+    fprintf (stderr, "backup: Write during a backup! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  /* And an explicit freeze cannot be thawed under it */
+  retval = rd_freeze (fd1);
+
+  if (retval < 0 || rd_thaw (fd1) >= 0) {
+    fprintf (stderr, "backup: Thawed during a backup! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  expected = sizeof(header) + (long) header.imageInodes * header.inodeSize +
+    header.bitmapSize + (long) header.imageBlocks * header.blockSize;
+  total = sizeof(header);
+  while ((retval = read (bfd, addr, sizeof(addr))) > 0)
+    total += retval;
+
+  if (retval < 0 || total != expected) {
+    fprintf (stderr, "backup: Image size error! read %ld of %ld\n",
+	     total, expected);
+
+    exit(EXIT_FAILURE);
+  }
+
+  close (bfd);
+
+  /* Still frozen by rd_freeze until it is thawed */
+  retval = rd_pwrite (fd1, fd, data1, 16, 0);
+
+  if (retval >= 0 || rd_thaw (fd1) < 0) {
+    fprintf (stderr, "backup: Freeze lost with the image! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  retval = rd_pwrite (fd1, fd, data1, 16, 0);
+
+  if (retval != 16) {
+    fprintf (stderr, "backup: Write after the backup error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+
+  CLOSE (fd1, fd);
+  retval = UNLINK (fd1, PATH_PREFIX "/backupfile");
+
+  if (retval < 0) {
+    fprintf (stderr, "unlink: /backupfile file deletion error! status: %d\n",
+	     retval);
+
+    exit(EXIT_FAILURE);
+  }
+  }
+#endif // USE_RAMDISK
+#endif // TEST15
+
   
   printf("Congratulations, you have passed all tests!!\n");
   